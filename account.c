@@ -0,0 +1,150 @@
+// Accounting of the load caused by each client.
+//
+// XIDs of a client share its resource base (the bits outside the resource ID
+// mask of the server), so the windows are attributed to their owners without
+// asking the server. The events handled about the windows of a client, the
+// time spent on them, the requests sent about its windows (by XCB_SEND in
+// wm0.h) and the BadWindow errors caused by them (see origin.c) are counted
+// in a table keyed by the resource base. The table is written to the standard
+// output on SIGUSR2, to find out which application keeps the WM busy.
+//
+// Resource bases are reused by the server after a client disconnects, so a
+// row may add up several clients which had the same base over time.
+// Events and requests about the root or no window are not counted, except
+// the pointer events of a drag, which are counted for the dragged window.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "wm0.h"
+#include "window.h"
+#include "account.h"
+
+// Number of slots of the table (power of 2)
+// X servers accept 256 clients by default, so the table is kept sparse.
+#define TABLE_SIZE 512
+
+struct client {
+    uint32_t base;        // Resource base of the client
+    bool used;            // Whether the slot is used
+    uint32_t events;      // Events handled about its windows
+    uint32_t requests;    // Requests sent about its windows
+    uint32_t bad_window;  // BadWindow errors about its windows
+    uint64_t time;        // Time spent to handle its events (ns)
+};
+
+static struct client table[TABLE_SIZE];
+static uint32_t id_mask = 0x1fffff;  // Resource ID mask (X.Org by default)
+static struct client *handled;  // Client of the event being handled, or NULL
+static uint64_t start;          // Time when the event started to be handled
+
+static uint64_t now(void);
+static struct client *lookup(xcb_window_t window);
+
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Find the client owning the window, adding it to the table if it is not
+// there yet. Return NULL if the window is the root or none, or if the table
+// is full.
+static struct client *
+lookup(xcb_window_t window)
+{
+    uint32_t base = window & ~id_mask;
+    // Resource bases differ in the high bits.
+    size_t i = (base * 2654435761u) >> 23 & (TABLE_SIZE - 1);
+
+    if (window == XCB_NONE || window == wm.screen->root)
+        return NULL;
+    for (size_t n = 0; n < TABLE_SIZE; ++n, i = (i + 1) & (TABLE_SIZE - 1)) {
+        if (!table[i].used) {
+            table[i].used = true;
+            table[i].base = base;
+            return &table[i];
+        }
+        if (table[i].base == base)
+            return &table[i];
+    }
+    return NULL;
+}
+
+// Set the resource ID mask of the server.
+void
+account_init(uint32_t resource_id_mask)
+{
+    id_mask = resource_id_mask;
+}
+
+// Start handling the event.
+// The pointer is grabbed on the root during a drag, so the pointer events
+// are attributed to the window being dragged.
+void
+account_begin(const xcb_generic_event_t *event)
+{
+    uint8_t type = event->response_type & ~0x80;
+    struct window *win = window_get_current();
+    xcb_window_t window;
+
+    if (wm.grab.mode != NO_GRAB && win != NULL &&
+        (type == XCB_MOTION_NOTIFY || type == XCB_BUTTON_RELEASE))
+        window = win->id;
+    else
+        window = type == 0 ? XCB_NONE : handle_event_window(event);
+    handled = lookup(window);
+    if (handled != NULL)
+        ++handled->events;
+    start = now();
+}
+
+// Finish handling the event.
+void
+account_end(void)
+{
+    if (handled != NULL)
+        handled->time += now() - start;
+    handled = NULL;
+}
+
+// Count the request about the window, and return its sequence number.
+unsigned int
+account_request(xcb_window_t window, unsigned int sequence)
+{
+    struct client *c = lookup(window);
+
+    if (c != NULL)
+        ++c->requests;
+    return sequence;
+}
+
+// Count a BadWindow error caused by a request about the window.
+void
+account_bad_window(xcb_window_t window)
+{
+    struct client *c = lookup(window);
+
+    if (c != NULL)
+        ++c->bad_window;
+}
+
+// Write the table.
+void
+account_dump(FILE *fp)
+{
+    fprintf(fp, "%-10s %10s %10s %10s %12s\n", "client", "events", "requests",
+        "BadWindow", "time(us)");
+    for (int i = 0; i < TABLE_SIZE; ++i) {
+        const struct client *c = &table[i];
+
+        if (!c->used)
+            continue;
+        fprintf(fp, "0x%08x %10u %10u %10u %12.1f\n", c->base, c->events,
+            c->requests, c->bad_window, c->time / 1000.0);
+    }
+    fflush(fp);
+}
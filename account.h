@@ -0,0 +1,14 @@
+#ifndef WM0_ACCOUNT_H
+#define WM0_ACCOUNT_H
+
+#include <stdio.h>
+#include <xcb/xcb.h>
+
+void account_init(uint32_t resource_id_mask);
+void account_begin(const xcb_generic_event_t *event);
+void account_end(void);
+unsigned int account_request(xcb_window_t window, unsigned int sequence);
+void account_bad_window(xcb_window_t window);
+void account_dump(FILE *fp);
+
+#endif // WM0_ACCOUNT_H
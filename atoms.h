@@ -0,0 +1,17 @@
+#ifndef WM0_ATOMS_H
+#define WM0_ATOMS_H
+
+#include <xcb/xcb.h>
+
+// Atoms used by the WM, other than the predefined ones (XCB_ATOM_*).
+// They are interned at the start, and names are listed in wm0.c.
+struct atoms {
+    xcb_atom_t wm_protocols;
+    xcb_atom_t wm_state;
+    xcb_atom_t wm_change_state;
+    xcb_atom_t net_wm_sync_request;
+    xcb_atom_t net_wm_sync_request_counter;
+    xcb_atom_t wm_window_role;
+};
+
+#endif // WM0_ATOMS_H
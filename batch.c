@@ -0,0 +1,103 @@
+// Scheduler of the events within a batch.
+//
+// The event loop pushes all the events available at once, and then pops them
+// one by one. While the pointer is grabbed, the input events for the grab
+// (ButtonPress, ButtonRelease and MotionNotify) are served before the other
+// events, so that dragging a window does not wait for a storm of MapRequest
+// or ConfigureRequest from clients. Otherwise, and within each kind, events
+// are served in the order they arrived.
+
+#include <xcb/xcb_event.h>  // for XCB_EVENT_RESPONSE_TYPE
+#include "wm0.h"
+#include "batch.h"
+
+// FIFO of events
+struct queue {
+    struct {
+        xcb_generic_event_t *event;
+        unsigned int order;  // Order of arrival
+    } entries[BATCH_SIZE];
+    unsigned int head, tail;
+};
+
+static struct queue input;     // Input events
+static struct queue other;     // Other events (and errors)
+static unsigned int arrivals;  // Number of events pushed
+
+static bool
+is_input(const xcb_generic_event_t *event)
+{
+    switch (XCB_EVENT_RESPONSE_TYPE(event)) {
+    case XCB_BUTTON_PRESS:
+    case XCB_BUTTON_RELEASE:
+    case XCB_MOTION_NOTIFY:
+        return true;
+    }
+    return false;
+}
+
+static bool
+is_empty(const struct queue *q)
+{
+    return q->head == q->tail;
+}
+
+// Check if no more events can be pushed.
+bool
+batch_full(void)
+{
+    return (input.tail - input.head) + (other.tail - other.head) == BATCH_SIZE;
+}
+
+// Push an event. batch_full() must be false.
+// Consecutive MotionNotify events are merged, since only the latest position
+// of the pointer matters. The merged event takes the place of the latest
+// one, so that it is not handled before the events which arrived between
+// them. In that case, the event which is no longer needed is returned, and
+// it must be freed by the caller. Otherwise NULL is returned.
+xcb_generic_event_t *
+batch_push(xcb_generic_event_t *event)
+{
+    struct queue *q = is_input(event) ? &input : &other;
+
+    if (q == &input && !is_empty(q) &&
+        XCB_EVENT_RESPONSE_TYPE(event) == XCB_MOTION_NOTIFY) {
+        unsigned int last = (q->tail - 1) % BATCH_SIZE;
+        xcb_generic_event_t *merged = q->entries[last].event;
+
+        if (XCB_EVENT_RESPONSE_TYPE(merged) == XCB_MOTION_NOTIFY) {
+            q->entries[last].event = event;
+            q->entries[last].order = arrivals++;
+            return merged;
+        }
+    }
+
+    q->entries[q->tail % BATCH_SIZE].event = event;
+    q->entries[q->tail % BATCH_SIZE].order = arrivals++;
+    ++q->tail;
+    return NULL;
+}
+
+// Pop the next event to handle, or NULL if there are no events.
+xcb_generic_event_t *
+batch_pop(void)
+{
+    struct queue *q;
+
+    if (is_empty(&input) && is_empty(&other))
+        return NULL;
+
+    if (is_empty(&other))
+        q = &input;
+    else if (is_empty(&input))
+        q = &other;
+    else if (wm.grab.mode != NO_GRAB)
+        q = &input;
+    else if ((int)(input.entries[input.head % BATCH_SIZE].order -
+            other.entries[other.head % BATCH_SIZE].order) < 0)
+        q = &input;
+    else
+        q = &other;
+
+    return q->entries[q->head++ % BATCH_SIZE].event;
+}
@@ -0,0 +1,13 @@
+#ifndef WM0_BATCH_H
+#define WM0_BATCH_H
+
+#include <stdbool.h>
+#include <xcb/xcb.h>
+
+#define BATCH_SIZE 256  // Maximum number of events in a batch
+
+bool batch_full(void);
+xcb_generic_event_t *batch_push(xcb_generic_event_t *event);
+xcb_generic_event_t *batch_pop(void);
+
+#endif // WM0_BATCH_H
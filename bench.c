@@ -0,0 +1,311 @@
+// wm0-bench - Micro-benchmarks of the window operations and the handlers.
+//
+// This is linked with fakexcb.c instead of libxcb, so the X server is not
+// needed. For each benchmark, the time and the number of requests (and
+// round trips) per operation are reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wm0.h"
+#include "window.h"
+#include "rules.h"
+#include "monitor.h"
+#include "fakexcb.h"
+
+#define NWINDOWS   1000     // Number of managed windows
+#define ITERATIONS 1000000  // Number of operations for each benchmark
+#define BASE_ID    0x400000 // XID of the first window
+#define NRULES     500      // Number of window rules
+
+struct wm wm;
+
+static xcb_screen_t screen;
+static uint64_t start;
+
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Pseudo random numbers, to avoid depending on the libc implementation.
+static uint32_t
+xorshift(void)
+{
+    static uint32_t x = 2463534242;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// Append the replies needed for window_manage() to the script.
+static void
+push_manage_replies(int i)
+{
+    xcb_get_geometry_reply_t geometry = {
+        .response_type = 1,  // Reply
+        .x = i % 800, .y = i % 600, .width = 100, .height = 100,
+    };
+    xcb_get_property_reply_t empty = {
+        .response_type = 1,  // Reply
+    };
+
+    fake_push_reply(XCB_GET_GEOMETRY, &geometry, sizeof(geometry));
+    // WM_NORMAL_HINTS, WM_CLASS, WM_TRANSIENT_FOR, WM_PROTOCOLS and
+    // _NET_WM_SYNC_REQUEST_COUNTER
+    for (int i = 0; i < 5; ++i)
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+}
+
+// Append the replies needed for handle_map_request() to the script.
+static void
+push_map_replies(int i)
+{
+    xcb_get_window_attributes_reply_t attributes = {
+        .response_type = 1,  // Reply
+        .map_state = XCB_MAP_STATE_UNMAPPED,
+    };
+
+    fake_push_reply(XCB_GET_WINDOW_ATTRIBUTES, &attributes,
+        sizeof(attributes));
+    push_manage_replies(i);
+}
+
+// Set up the state of the WM with NWINDOWS managed windows.
+static void
+setup(void)
+{
+    screen.root = 1;
+    screen.width_in_pixels = 1920;
+    screen.height_in_pixels = 1080;
+    wm.screen = &screen;
+    // Pretend that XSync is available, and the atoms are interned.
+    wm.sync_event = 90;
+    wm.atoms = (struct atoms) { 300, 301, 302, 303, 304 };
+    wm.grab.mode = NO_GRAB;
+    conf_default(&wm.conf);
+
+    window_init();
+    for (int i = 0; i < NWINDOWS; ++i) {
+        push_manage_replies(i);
+        window_manage(BASE_ID + i, NULL, true);
+    }
+}
+
+static void
+begin(void)
+{
+    fake_reset();
+    start = now();
+}
+
+static void
+end(const char *name, unsigned long n)
+{
+    uint64_t t = now() - start;
+
+    printf("%-30s %10lu %10.1f %10.2f %10.2f\n", name, n, (double)t / n,
+        (double)fake_stats.requests / n, (double)fake_stats.round_trips / n);
+}
+
+static void
+bench_window_find(void)
+{
+    unsigned long found = 0;
+
+    begin();
+    for (int i = 0; i < ITERATIONS / 100; ++i)
+        found += window_find(BASE_ID + xorshift() % NWINDOWS) != NULL;
+    end("window_find (hit)", ITERATIONS / 100);
+
+    begin();
+    for (int i = 0; i < ITERATIONS / 100; ++i)
+        found += window_find(BASE_ID - 1 - i) != NULL;
+    end("window_find (miss)", ITERATIONS / 100);
+
+    if (found != ITERATIONS / 100)
+        fprintf(stderr, "window_find: unexpected result\n");
+}
+
+static void
+bench_window_focus(void)
+{
+    struct window *a = window_find(BASE_ID), *b = window_find(BASE_ID + 1);
+
+    begin();
+    for (int i = 0; i < ITERATIONS; ++i)
+        window_focus(i % 2 ? a : b);
+    end("window_focus", ITERATIONS);
+}
+
+static void
+bench_motion(int mode, const char *name)
+{
+    xcb_motion_notify_event_t ev = { .response_type = XCB_MOTION_NOTIFY };
+    struct window *win = window_find(BASE_ID);
+
+    window_focus(win);
+    wm.grab.mode = mode;
+    wm.grab.x = wm.grab.y = 0;
+    wm.grab.win_x = win->x;
+    wm.grab.win_y = win->y;
+    wm.grab.win_w = win->w;
+    wm.grab.win_h = win->h;
+
+    begin();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        // Move the pointer back and forth.
+        ev.root_x = ev.root_y = i % 200 < 100 ? i % 100 : 100 - i % 100;
+        handle_event((xcb_generic_event_t *)&ev);
+    }
+    end(name, ITERATIONS);
+
+    wm.grab.mode = NO_GRAB;
+}
+
+static void
+bench_click(void)
+{
+    xcb_button_press_event_t ev = {
+        .response_type = XCB_BUTTON_PRESS,
+        .detail = 1,
+    };
+
+    begin();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        ev.event = BASE_ID + xorshift() % NWINDOWS;
+        handle_event((xcb_generic_event_t *)&ev);
+    }
+    end("ButtonPress (click to focus)", ITERATIONS);
+}
+
+static void
+bench_map_unmap(void)
+{
+    xcb_map_request_event_t map = { .response_type = XCB_MAP_REQUEST };
+    xcb_unmap_notify_event_t unmap = { .response_type = XCB_UNMAP_NOTIFY };
+    int n = ITERATIONS / 100;
+
+    // Prepare the replies in advance, so that they are not measured.
+    fake_reset();
+    for (int i = 0; i < n; ++i)
+        push_map_replies(i);
+
+    start = now();
+    for (int i = 0; i < n; ++i) {
+        map.window = unmap.window = BASE_ID + NWINDOWS + i;
+        handle_event((xcb_generic_event_t *)&map);
+        handle_event((xcb_generic_event_t *)&unmap);
+    }
+    end("MapRequest + UnmapNotify", n);
+}
+
+// Switch between a desktop with all the windows and an empty one.
+// Each switch includes the UnmapNotify events caused by it.
+static void
+bench_desktop_switch(void)
+{
+    xcb_unmap_notify_event_t unmap = { .response_type = XCB_UNMAP_NOTIFY };
+    int n = ITERATIONS / NWINDOWS;
+
+    begin();
+    for (int i = 0; i < n; ++i) {
+        window_switch_desktop(1);
+        for (int j = 0; j < NWINDOWS; ++j) {
+            unmap.window = BASE_ID + j;
+            handle_event((xcb_generic_event_t *)&unmap);
+        }
+        window_switch_desktop(0);
+    }
+    end("desktop switch (1000 windows)", n * 2);
+}
+
+// Find the monitors of random points on three monitors.
+static void
+bench_monitor_at(void)
+{
+    unsigned long found = 0;
+
+    monitor_set((const struct monitor []) {
+        { 1, 0, 0, 1920, 1080 }, { 2, 1920, 0, 1280, 1024 },
+        { 3, 0, 1080, 1920, 1080 },
+    }, 3);
+
+    begin();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        uint32_t r = xorshift();
+
+        found += monitor_at(r % 1920, r / 1920 % 1080)->crtc != 0;
+    }
+    end("monitor_at", ITERATIONS);
+
+    if (found != ITERATIONS)
+        fprintf(stderr, "monitor_at: unexpected result\n");
+    monitor_set(NULL, 0);
+}
+
+// Match windows against NRULES rules, half of which are prefixes.
+static void
+bench_rules_match(void)
+{
+    static char classes[NRULES][16];
+    char line[64];
+    unsigned long matched = 0;
+
+    rules_clear();
+    for (int i = 0; i < NRULES; ++i) {
+        snprintf(line, sizeof(line), i % 2 ? "App%d desktop=2" :
+            "Tool%d:* focus=no", i);
+        rules_parse(line);
+        snprintf(classes[i], sizeof(classes[i]), i % 2 ? "App%d" : "Tool%d",
+            i);
+    }
+    rules_compile();
+
+    begin();
+    for (int i = 0; i < ITERATIONS; ++i)
+        matched += rules_match("app", classes[xorshift() % NRULES | 1]).set != 0;
+    end("rules_match (exact)", ITERATIONS);
+
+    begin();
+    for (int i = 0; i < ITERATIONS; ++i)
+        matched += rules_match("tool", classes[xorshift() % NRULES & ~1]).set != 0;
+    end("rules_match (prefix)", ITERATIONS);
+
+    begin();
+    for (int i = 0; i < ITERATIONS; ++i)
+        matched += rules_match("xterm", "XTerm").set != 0;
+    end("rules_match (miss)", ITERATIONS);
+
+    if (matched != 2 * ITERATIONS)
+        fprintf(stderr, "rules_match: unexpected result\n");
+    rules_clear();
+}
+
+int
+main(void)
+{
+    setup();
+
+    printf("%-30s %10s %10s %10s %10s\n", "benchmark", "ops", "ns/op",
+        "requests", "roundtrips");
+    bench_window_find();
+    bench_window_focus();
+    bench_motion(GRAB_MOVE, "MotionNotify (move)");
+    bench_motion(GRAB_RESIZE, "MotionNotify (resize)");
+    bench_click();
+    bench_map_unmap();
+    bench_desktop_switch();
+    bench_monitor_at();
+    bench_rules_match();
+
+    window_unmanage_all();
+    return 0;
+}
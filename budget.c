@@ -0,0 +1,929 @@
+// wm0-budget - Check the number of round trips and requests of each user
+// operation against its budget.
+//
+// This is linked with fakexcb.c instead of libxcb, so the X server is not
+// needed. It fails if any operation exceeds its budget, e.g. when a new
+// synchronous reply sneaks into a hot path.
+// When an operation gets cheaper, lower its budget.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "wm0.h"
+#include "window.h"
+#include "monitor.h"
+#include "compositor.h"
+#include "overview.h"
+#include "tile.h"
+#include "places.h"
+#include "fakexcb.h"
+
+#define NWINDOWS 10        // Number of windows managed before each operation
+#define BASE_ID  0x400000  // XID of the first window
+#define NGROUP   5         // Number of transients in a group
+
+struct wm wm;
+
+static xcb_screen_t screen;
+static unsigned long misplaced;  // Number of windows left at a wrong place
+
+static void setup(void);
+
+// Append the replies needed for window_manage() to the script.
+static void
+push_manage_replies(void)
+{
+    xcb_get_geometry_reply_t geometry = {
+        .response_type = 1,  // Reply
+        .x = 10, .y = 10, .width = 100, .height = 100,
+    };
+    xcb_get_property_reply_t empty = {
+        .response_type = 1,  // Reply
+    };
+
+    fake_push_reply(XCB_GET_GEOMETRY, &geometry, sizeof(geometry));
+    // WM_NORMAL_HINTS, WM_CLASS, WM_TRANSIENT_FOR, WM_PROTOCOLS and
+    // _NET_WM_SYNC_REQUEST_COUNTER
+    for (int i = 0; i < 5; ++i)
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+}
+
+// Make the windows next to the first one its transients.
+static void
+make_group(void)
+{
+    xcb_get_geometry_reply_t geometry = {
+        .response_type = 1,  // Reply
+        .x = 20, .y = 20, .width = 50, .height = 50,
+    };
+    xcb_get_property_reply_t empty = {
+        .response_type = 1,  // Reply
+    };
+    struct {
+        xcb_get_property_reply_t reply;
+        xcb_window_t value;
+    } transient_for = {
+        .reply = {
+            .response_type = 1,  // Reply
+            .format = 32,
+            .length = 1,
+            .value_len = 1,
+        },
+        .value = BASE_ID,
+    };
+
+    for (int i = 1; i <= NGROUP; ++i) {
+        window_unmanage(window_find(BASE_ID + i), false);
+        fake_push_reply(XCB_GET_GEOMETRY, &geometry, sizeof(geometry));
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+        fake_push_reply(XCB_GET_PROPERTY, &transient_for,
+            sizeof(transient_for));
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+        window_manage(BASE_ID + i, NULL, true);
+    }
+    fake_reset();
+}
+
+// Append the reply of GetWindowAttributes to the script.
+static void
+push_attributes_reply(uint8_t map_state)
+{
+    xcb_get_window_attributes_reply_t attributes = {
+        .response_type = 1,  // Reply
+        .map_state = map_state,
+    };
+
+    fake_push_reply(XCB_GET_WINDOW_ATTRIBUTES, &attributes,
+        sizeof(attributes));
+}
+
+// Append the reply of GrabPointer to the script.
+static void
+push_grab_reply(void)
+{
+    xcb_grab_pointer_reply_t grab = {
+        .response_type = 1,  // Reply
+        .status = XCB_GRAB_STATUS_SUCCESS,
+    };
+
+    fake_push_reply(XCB_GRAB_POINTER, &grab, sizeof(grab));
+}
+
+static void
+button_press(xcb_window_t id, uint8_t button, uint16_t state)
+{
+    xcb_button_press_event_t ev = {
+        .response_type = XCB_BUTTON_PRESS,
+        .event = id,
+        .detail = button,
+        .state = state,
+    };
+
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+static void
+op_scan(void)
+{
+    struct {
+        xcb_query_tree_reply_t reply;
+        xcb_window_t children[NWINDOWS];
+    } tree = {
+        .reply = {
+            .response_type = 1,  // Reply
+            .length = NWINDOWS,
+            .children_len = NWINDOWS,
+        },
+    };
+    xcb_get_property_reply_t empty = {
+        .response_type = 1,  // Reply
+    };
+
+    // Start from no windows.
+    window_unmanage_all();
+    fake_reset();
+
+    for (int i = 0; i < NWINDOWS; ++i)
+        tree.children[i] = BASE_ID + NWINDOWS + i;
+    fake_push_reply(XCB_QUERY_TREE, &tree, sizeof(tree));
+    for (int i = 0; i < NWINDOWS; ++i) {
+        push_attributes_reply(XCB_MAP_STATE_VIEWABLE);
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));  // WM_STATE
+        push_manage_replies();
+    }
+    window_scan();
+}
+
+static void
+op_map(void)
+{
+    xcb_map_request_event_t ev = {
+        .response_type = XCB_MAP_REQUEST,
+        .window = BASE_ID + NWINDOWS,
+    };
+
+    push_attributes_reply(XCB_MAP_STATE_UNMAPPED);
+    push_manage_replies();
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+static void
+op_unmap(void)
+{
+    xcb_unmap_notify_event_t ev = {
+        .response_type = XCB_UNMAP_NOTIFY,
+        .window = BASE_ID,
+    };
+
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+static void
+op_click(void)
+{
+    button_press(BASE_ID + 1, wm.conf.button_move, 0);
+}
+
+// Click a transient, which raises its whole group.
+static void
+op_click_group(void)
+{
+    make_group();
+    button_press(BASE_ID + 1, wm.conf.button_move, 0);
+}
+
+static void
+op_drag_start(void)
+{
+    push_grab_reply();
+    button_press(BASE_ID + 1, wm.conf.button_move, wm.conf.modkey);
+}
+
+static void
+op_drag_step(void)
+{
+    xcb_motion_notify_event_t ev = {
+        .response_type = XCB_MOTION_NOTIFY,
+        .root_x = 20, .root_y = 20,
+    };
+
+    push_grab_reply();
+    button_press(BASE_ID, wm.conf.button_move, wm.conf.modkey);
+    handle_event((xcb_generic_event_t *)&ev);
+    fake_reset();
+
+    ev.root_x = ev.root_y = 21;
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+// Drag a window next to an iconified window and a window on another
+// desktop, whose edges must not catch it.
+static void
+op_drag_hidden(void)
+{
+    xcb_motion_notify_event_t ev = {
+        .response_type = XCB_MOTION_NOTIFY,
+        .root_x = 399, .root_y = 399,
+    };
+    struct window *win = window_find(BASE_ID);
+
+    window_move(window_find(BASE_ID + 1), 413, 440);
+    window_iconify(window_find(BASE_ID + 1));
+    window_move(window_find(BASE_ID + 2), 440, 413);
+    window_send_to_desktop(window_find(BASE_ID + 2), 1);
+    push_grab_reply();
+    button_press(BASE_ID, wm.conf.button_move, wm.conf.modkey);
+    handle_event((xcb_generic_event_t *)&ev);
+    fake_reset();
+
+    ev.root_x = ev.root_y = 400;
+    handle_event((xcb_generic_event_t *)&ev);
+    if (win->x != 410 || win->y != 410)
+        ++misplaced;
+}
+
+// Move a leader, which moves its transients as well.
+static void
+op_drag_group(void)
+{
+    make_group();
+    op_drag_step();
+}
+
+// Resize a terminal-like window by less than its resize increment.
+static void
+op_resize_step(void)
+{
+    xcb_motion_notify_event_t ev = {
+        .response_type = XCB_MOTION_NOTIFY,
+        .root_x = 20, .root_y = 20,
+    };
+    struct window *win = window_find(BASE_ID);
+
+    win->hints.inc_w = win->hints.inc_h = 10;
+    push_grab_reply();
+    button_press(BASE_ID, wm.conf.button_resize, wm.conf.modkey);
+    handle_event((xcb_generic_event_t *)&ev);
+    fake_reset();
+
+    ev.root_x = ev.root_y = 25;
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+// Resize a window supporting _NET_WM_SYNC_REQUEST before it redraws.
+static void
+op_resize_sync(void)
+{
+    xcb_motion_notify_event_t ev = {
+        .response_type = XCB_MOTION_NOTIFY,
+        .root_x = 20, .root_y = 20,
+    };
+
+    window_find(BASE_ID)->sync.counter = 0x500000;
+    push_grab_reply();
+    button_press(BASE_ID, wm.conf.button_resize, wm.conf.modkey);
+    handle_event((xcb_generic_event_t *)&ev);
+    fake_reset();
+
+    ev.root_x = ev.root_y = 40;
+    ev.time = 1;
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+static void
+op_drag_end(void)
+{
+    xcb_button_release_event_t ev = { .response_type = XCB_BUTTON_RELEASE };
+
+    push_grab_reply();
+    button_press(BASE_ID, wm.conf.button_move, wm.conf.modkey);
+    fake_reset();
+
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+// Operations with the windows in frames
+static void
+op_map_frames(void)
+{
+    wm.frames = true;
+    setup();
+    op_map();
+    wm.frames = false;
+}
+
+static void
+op_drag_step_frames(void)
+{
+    wm.frames = true;
+    setup();
+    op_drag_step();
+    wm.frames = false;
+}
+
+static void
+op_drag_end_frames(void)
+{
+    wm.frames = true;
+    setup();
+    op_drag_end();
+    wm.frames = false;
+}
+
+// Destroy the focused window, where only the frame is left to destroy.
+static void
+op_destroy_frames(void)
+{
+    xcb_destroy_notify_event_t ev = {
+        .response_type = XCB_DESTROY_NOTIFY,
+        .window = BASE_ID,
+    };
+
+    wm.frames = true;
+    setup();
+    handle_event((xcb_generic_event_t *)&ev);
+    wm.frames = false;
+}
+
+// Operations while compositing, where all windows are mapped on top of each
+// other, and painted once before the operation.
+static void
+setup_composited(void)
+{
+    wm.frames = wm.compositing = true;
+    setup();
+    for (int i = NWINDOWS - 1; i >= 0; --i)
+        window_map(window_find(BASE_ID + i));
+    compositor_paint();
+    fake_reset();
+}
+
+// A client draws into the top window, which is the only one repainted.
+static void
+op_damage(void)
+{
+    xcb_damage_notify_event_t ev = {
+        .response_type = 110 + XCB_DAMAGE_NOTIFY,
+        .area = { 10, 10, 20, 20 },
+    };
+
+    setup_composited();
+    ev.drawable = window_find(BASE_ID)->frame;
+    handle_event((xcb_generic_event_t *)&ev);
+    compositor_paint();
+    wm.frames = wm.compositing = false;
+}
+
+// The server exposes an area of the root, which is repainted.
+static void
+op_expose_root(void)
+{
+    xcb_expose_event_t ev = {
+        .response_type = XCB_EXPOSE,
+        .x = 10, .y = 10, .width = 20, .height = 20,
+    };
+
+    setup_composited();
+    ev.window = wm.screen->root;
+    handle_event((xcb_generic_event_t *)&ev);
+    compositor_paint();
+    wm.frames = wm.compositing = false;
+}
+
+// Open the overview for the first time, which renders all thumbnails.
+static void
+op_overview(void)
+{
+    xcb_key_press_event_t ev = {
+        .response_type = XCB_KEY_PRESS,
+        .detail = wm.overview_key,
+        .state = wm.conf.modkey,
+    };
+
+    setup_composited();
+    handle_event((xcb_generic_event_t *)&ev);
+    compositor_paint();
+    wm.frames = wm.compositing = false;
+}
+
+// Open the overview again after a window was drawn, which renders only its
+// thumbnail again.
+static void
+op_overview_again(void)
+{
+    xcb_key_press_event_t ev = {
+        .response_type = XCB_KEY_PRESS,
+        .detail = wm.overview_key,
+        .state = wm.conf.modkey,
+    };
+    xcb_damage_notify_event_t damage = {
+        .response_type = 110 + XCB_DAMAGE_NOTIFY,
+        .area = { 10, 10, 20, 20 },
+    };
+
+    setup_composited();
+    for (int i = 0; i < 2; ++i) {
+        handle_event((xcb_generic_event_t *)&ev);
+        compositor_paint();
+    }
+    damage.drawable = window_find(BASE_ID)->frame;
+    handle_event((xcb_generic_event_t *)&damage);
+    compositor_paint();
+    fake_reset();
+
+    handle_event((xcb_generic_event_t *)&ev);
+    compositor_paint();
+    wm.frames = wm.compositing = false;
+}
+
+// Move the top window by a pixel, which repaints it and the window below.
+static void
+op_drag_step_composited(void)
+{
+    xcb_motion_notify_event_t ev = {
+        .response_type = XCB_MOTION_NOTIFY,
+        .root_x = 20, .root_y = 20,
+    };
+
+    setup_composited();
+    push_grab_reply();
+    button_press(BASE_ID, wm.conf.button_move, wm.conf.modkey);
+    handle_event((xcb_generic_event_t *)&ev);
+    compositor_paint();
+    fake_reset();
+
+    ev.root_x = ev.root_y = 21;
+    handle_event((xcb_generic_event_t *)&ev);
+    compositor_paint();
+    wm.frames = wm.compositing = false;
+}
+
+// Switch to a desktop, where half of the windows are.
+static void
+op_desktop_switch(void)
+{
+    xcb_key_press_event_t ev = {
+        .response_type = XCB_KEY_PRESS,
+        .detail = wm.keycodes[1],
+        .state = wm.conf.modkey,
+    };
+
+    for (int i = 0; i < NWINDOWS; i += 2)
+        window_find(BASE_ID + i)->desktop = 1;
+    fake_reset();
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+// UnmapNotify caused by the desktop switch
+static void
+op_desktop_unmap(void)
+{
+    xcb_unmap_notify_event_t ev = { .response_type = XCB_UNMAP_NOTIFY };
+
+    window_switch_desktop(1);
+    fake_reset();
+    for (int i = 0; i < NWINDOWS; ++i) {
+        ev.window = BASE_ID + i;
+        handle_event((xcb_generic_event_t *)&ev);
+    }
+}
+
+// Move the second monitor, which is followed without asking RandR.
+static void
+op_crtc_change(void)
+{
+    xcb_randr_notify_event_t ev = {
+        .response_type = 100 + XCB_RANDR_NOTIFY,
+        .subCode = XCB_RANDR_NOTIFY_CRTC_CHANGE,
+        .u.cc = {
+            .crtc = 2, .mode = 1,
+            .x = 1920, .y = 100, .width = 1280, .height = 1024,
+        },
+    };
+
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+// Iconify a window by WM_CHANGE_STATE.
+static void
+op_iconify(void)
+{
+    xcb_client_message_event_t ev = {
+        .response_type = XCB_CLIENT_MESSAGE,
+        .format = 32,
+        .window = BASE_ID,
+        .type = wm.atoms.wm_change_state,
+        .data.data32 = { WM_STATE_ICONIC },
+    };
+
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+// Restore an iconified window by MapRequest.
+static void
+op_restore(void)
+{
+    xcb_map_request_event_t ev = {
+        .response_type = XCB_MAP_REQUEST,
+        .window = BASE_ID + 1,
+    };
+
+    window_iconify(window_find(BASE_ID + 1));
+    fake_reset();
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+// Lay out the windows in the layout, before the operation.
+static void
+setup_tiled(uint8_t layout)
+{
+    tile_set_layout(wm.desktop, layout);
+    tile_arrange(wm.desktop);
+    fake_reset();
+}
+
+// Append the replies needed for window_manage() with WM_CLASS to the script,
+// when the positions are remembered.
+static void
+push_class_replies(void)
+{
+    xcb_get_geometry_reply_t geometry = {
+        .response_type = 1,  // Reply
+        .x = 10, .y = 10, .width = 100, .height = 100,
+    };
+    xcb_get_property_reply_t empty = {
+        .response_type = 1,  // Reply
+    };
+    struct {
+        xcb_get_property_reply_t reply;
+        char value[12];
+    } class = {
+        .reply = {
+            .response_type = 1,  // Reply
+            .format = 8,
+            .length = 3,
+            .value_len = 12,
+        },
+        .value = "xterm\0XTerm",
+    };
+
+    fake_push_reply(XCB_GET_GEOMETRY, &geometry, sizeof(geometry));
+    fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+    fake_push_reply(XCB_GET_PROPERTY, &class, sizeof(class));
+    // WM_WINDOW_ROLE, WM_TRANSIENT_FOR, WM_PROTOCOLS and
+    // _NET_WM_SYNC_REQUEST_COUNTER
+    for (int i = 0; i < 4; ++i)
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+}
+
+// Remember the positions in a temporary file, which starts with the
+// position (200, 200) for the windows of push_class_replies().
+static void
+open_places(void)
+{
+    char path[] = "/tmp/wm0-budget.XXXXXX";
+    int fd = mkstemp(path);
+    struct window *win;
+
+    if (fd < 0 || !places_open(path)) {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+    unlink(path);
+    push_class_replies();
+    win = window_manage(BASE_ID + NWINDOWS, NULL, true);
+    win->x = win->y = 200;
+    window_unmanage(win, false);
+    fake_reset();
+}
+
+// Map a window which was unmanaged elsewhere, and is moved back there.
+static void
+op_map_places(void)
+{
+    xcb_map_request_event_t ev = {
+        .response_type = XCB_MAP_REQUEST,
+        .window = BASE_ID + NWINDOWS,
+    };
+
+    open_places();
+
+    push_attributes_reply(XCB_MAP_STATE_UNMAPPED);
+    push_class_replies();
+    handle_event((xcb_generic_event_t *)&ev);
+    places_close();
+}
+
+// Scan two windows of an application with a remembered position, which are
+// left where they are rather than moved on top of each other.
+static void
+op_scan_places(void)
+{
+    struct {
+        xcb_query_tree_reply_t reply;
+        xcb_window_t children[2];
+    } tree = {
+        .reply = {
+            .response_type = 1,  // Reply
+            .length = 2,
+            .children_len = 2,
+        },
+        .children = { BASE_ID + NWINDOWS, BASE_ID + NWINDOWS + 1 },
+    };
+    xcb_get_property_reply_t empty = {
+        .response_type = 1,  // Reply
+    };
+    struct window *win;
+
+    window_unmanage_all();
+    open_places();
+
+    fake_push_reply(XCB_QUERY_TREE, &tree, sizeof(tree));
+    for (int i = 0; i < 2; ++i) {
+        push_attributes_reply(XCB_MAP_STATE_VIEWABLE);
+        fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));  // WM_STATE
+        push_class_replies();
+    }
+    window_scan();
+    places_close();
+
+    for (int i = 0; i < 2; ++i) {
+        win = window_find(tree.children[i]);
+        if (win == NULL || win->x != 10 || win->y != 10)
+            ++misplaced;
+    }
+}
+
+// Map a window at the end of the grid, which keeps its shape.
+static void
+op_map_grid(void)
+{
+    setup_tiled(LAYOUT_GRID);
+    op_map();
+}
+
+// Unmap the last window of the stack, whose windows grow.
+static void
+op_unmap_master(void)
+{
+    setup_tiled(LAYOUT_MASTER);
+    op_unmap();
+}
+
+// Modkey + drag a tiled window, which is refused without grabbing.
+static void
+op_drag_tiled(void)
+{
+    setup_tiled(LAYOUT_MASTER);
+    button_press(BASE_ID + 1, wm.conf.button_move, wm.conf.modkey);
+}
+
+// Switch from floating to master/stack by Modkey + Space.
+static void
+op_layout(void)
+{
+    xcb_key_press_event_t ev = {
+        .response_type = XCB_KEY_PRESS,
+        .detail = wm.layout_key,
+        .state = wm.conf.modkey,
+    };
+
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+// Change WM_NORMAL_HINTS, whose reply is taken after the event.
+static void
+op_hints(void)
+{
+    xcb_property_notify_event_t ev = {
+        .response_type = XCB_PROPERTY_NOTIFY,
+        .window = BASE_ID,
+        .atom = XCB_ATOM_WM_NORMAL_HINTS,
+    };
+
+    handle_event((xcb_generic_event_t *)&ev);
+}
+
+static void
+op_close(void)
+{
+    button_press(BASE_ID, wm.conf.button_close, wm.conf.modkey);
+}
+
+// Budgets of the operations
+static const struct {
+    const char *name;
+    void (*run)(void);
+    unsigned long round_trips;
+    unsigned long requests;
+} budgets[] = {
+    { "startup scan",        op_scan,                 2 + NWINDOWS,     3 + 22 * NWINDOWS },
+    { "map",                 op_map,                  2,                25 },
+    { "unmap (focused)",     op_unmap,                0,                2 },
+    { "click to focus",      op_click,                0,                5 },
+    { "click (group)",       op_click_group,          0,                5 + NGROUP },
+    { "drag start",          op_drag_start,           0,                6 },
+    { "drag step",           op_drag_step,            0,                1 },
+    { "drag step (group)",   op_drag_group,           0,                1 + NGROUP },
+    { "drag step (hidden)",  op_drag_hidden,          0,                1 },
+    { "resize step (< inc)", op_resize_step,          0,                0 },
+    { "resize step (sync)",  op_resize_sync,          0,                0 },
+    { "drag end",            op_drag_end,             0,                1 },
+    { "iconify",             op_iconify,              0,                4 },
+    { "restore",             op_restore,              0,                5 },
+    { "close",               op_close,                0,                3 },
+    { "desktop switch",      op_desktop_switch,       0,                NWINDOWS + 3 },
+    { "UnmapNotify (by WM)", op_desktop_unmap,        0,                0 },
+    { "CRTC change",         op_crtc_change,          0,                0 },
+    { "map (frames)",        op_map_frames,           2,                30 },
+    { "drag step (frames)",  op_drag_step_frames,     0,                1 },
+    { "drag end (frames)",   op_drag_end_frames,      0,                2 },
+    { "destroy (frames)",    op_destroy_frames,       0,                3 },
+    { "damage repaint",      op_damage,               0,                6 },
+    { "root Expose",         op_expose_root,          0,                5 },
+    { "drag step (comp.)",   op_drag_step_composited, 0,                16 },
+    { "overview",            op_overview,             0,                7 + 7 * NWINDOWS },
+    { "overview (cached)",   op_overview_again,       0,                11 + NWINDOWS },
+    { "map (grid)",          op_map_grid,             2,                26 },
+    { "unmap (master)",      op_unmap_master,         0,                NWINDOWS },
+    { "drag start (tiled)",  op_drag_tiled,           0,                5 },
+    { "layout switch",       op_layout,               0,                NWINDOWS },
+    { "map (remembered)",    op_map_places,           2,                27 },
+    { "scan (remembered)",   op_scan_places,          4,                49 },
+    { "hints change",        op_hints,                0,                1 },
+};
+
+// Record a session with the positions remembered to the trace, as `wm0 -p
+// places_file -t path` would: startup scan, a window mapped, destroyed and
+// mapped again, then a change of WM_NORMAL_HINTS, whose reply is taken
+// after the event as in run(). wm0-replay fails if the handlers ask for other replies
+// than the ones recorded, e.g. when the trace does not tell that the
+// windows were asked for WM_WINDOW_ROLE.
+static void
+record(const char *path)
+{
+    char places_path[] = "/tmp/wm0-budget.XXXXXX";
+    int fd = mkstemp(places_path);
+    struct {
+        xcb_query_tree_reply_t reply;
+        xcb_window_t children[1];
+    } tree = {
+        .reply = {
+            .response_type = 1,  // Reply
+            .length = 1,
+            .children_len = 1,
+        },
+        .children = { BASE_ID },
+    };
+    xcb_get_property_reply_t empty = {
+        .response_type = 1,  // Reply
+    };
+    xcb_map_request_event_t map = {
+        .response_type = XCB_MAP_REQUEST,
+        .window = BASE_ID + 1,
+    };
+    xcb_destroy_notify_event_t destroy = {
+        .response_type = XCB_DESTROY_NOTIFY,
+        .window = BASE_ID + 1,
+    };
+    xcb_property_notify_event_t hints = {
+        .response_type = XCB_PROPERTY_NOTIFY,
+        .window = BASE_ID,
+        .atom = XCB_ATOM_WM_NORMAL_HINTS,
+    };
+
+    window_unmanage_all();
+    window_init();
+    fake_reset();
+    // The places are opened first, as in main() of wm0.
+    if (fd < 0 || !places_open(places_path)) {
+        perror(places_path);
+        exit(1);
+    }
+    close(fd);
+    unlink(places_path);
+    if (!trace_open(path)) {
+        perror(path);
+        exit(1);
+    }
+
+    fake_push_reply(XCB_QUERY_TREE, &tree, sizeof(tree));
+    push_attributes_reply(XCB_MAP_STATE_VIEWABLE);
+    fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));  // WM_STATE
+    push_class_replies();
+    window_scan();
+
+    for (int i = 0; i < 2; ++i) {
+        trace_event((xcb_generic_event_t *)&map);
+        push_attributes_reply(XCB_MAP_STATE_UNMAPPED);
+        push_class_replies();
+        handle_event((xcb_generic_event_t *)&map);
+        if (i == 0) {
+            trace_event((xcb_generic_event_t *)&destroy);
+            handle_event((xcb_generic_event_t *)&destroy);
+        }
+    }
+
+    trace_event((xcb_generic_event_t *)&hints);
+    handle_event((xcb_generic_event_t *)&hints);
+    fake_push_reply(XCB_GET_PROPERTY, &empty, sizeof(empty));
+    window_poll_hints();
+
+    trace_close();
+    places_close();
+    window_unmanage_all();
+}
+
+// Set up the state of the WM before each operation.
+// NWINDOWS windows are managed, and the first one is focused.
+static void
+setup(void)
+{
+    overview_close();
+    window_unmanage_all();
+    compositor_stop();
+    window_init();
+    // Pretend that the root visual has a picture format.
+    if (wm.compositing)
+        compositor_start(1);
+    fake_reset();
+    wm.grab.mode = NO_GRAB;
+    wm.grab.sequence = 0;
+    for (int i = NWINDOWS - 1; i >= 0; --i) {
+        push_manage_replies();
+        window_manage(BASE_ID + i, NULL, true);
+    }
+    window_focus(window_find(BASE_ID));
+    for (int i = 0; i < DESKTOPS; ++i)
+        tile_set_layout(i, LAYOUT_FLOAT);
+    fake_reset();
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *trace_file = NULL;
+    int c, failures = 0;
+
+    while ((c = getopt(argc, argv, "t:")) != -1) {
+        switch (c) {
+        case 't':
+            trace_file = optarg;
+            break;
+        default:
+            fputs("usage: wm0-budget [-t trace_file]\n", stderr);
+            return 1;
+        }
+    }
+
+    screen.root = 1;
+    screen.width_in_pixels = 1920 + 1280;
+    screen.height_in_pixels = 1124;
+    wm.screen = &screen;
+    // Pretend that XSync, RandR and Damage are available, and the atoms are
+    // interned.
+    wm.sync_event = 90;
+    wm.randr_event = 100;
+    wm.damage_event = 110;
+    wm.atoms = (struct atoms) { 300, 301, 302, 303, 304, 305 };
+    conf_default(&wm.conf);
+    for (int i = 0; i < DESKTOPS; ++i)
+        wm.keycodes[i] = 10 + i;
+    wm.overview_key = 23;
+    wm.layout_key = 65;
+    monitor_set((const struct monitor []) {
+        { 1, 0, 0, 1920, 1080 }, { 2, 1920, 0, 1280, 1024 },
+    }, 2);
+
+    for (int i = 0; i < LENGTH(budgets); ++i) {
+        bool ok;
+
+        setup();
+        misplaced = 0;
+        budgets[i].run();
+        ok = fake_stats.round_trips <= budgets[i].round_trips &&
+            fake_stats.requests <= budgets[i].requests &&
+            fake_stats.unexpected == 0 && misplaced == 0;
+        if (!ok)
+            ++failures;
+        printf("%-4s %-20s round trips %3lu/%-3lu requests %3lu/%-3lu\n",
+            ok ? "ok" : "FAIL", budgets[i].name,
+            fake_stats.round_trips, budgets[i].round_trips,
+            fake_stats.requests, budgets[i].requests);
+        if (fake_stats.unexpected != 0) {
+            printf("     %lu replies were missing in the script\n",
+                fake_stats.unexpected);
+        }
+        if (misplaced != 0)
+            printf("     %lu windows were left at a wrong place\n", misplaced);
+    }
+    window_unmanage_all();
+
+    if (trace_file != NULL)
+        record(trace_file);
+    return failures > 0;
+}
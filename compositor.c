@@ -0,0 +1,584 @@
+// Built-in compositor, enabled by `wm0 -c`.
+//
+// Each frame is redirected to an offscreen pixmap by Composite, and wm0
+// paints the screen with Render. The geometry and the stacking order of the
+// frames are taken from window.c, so the server is never asked for them.
+//
+// The areas to repaint are collected as rectangles: Damage reports the ones
+// drawn by the clients, and window.c the ones exposed by moving, resizing,
+// mapping and restacking the frames. When the event loop runs out of events,
+// only the union of the rectangles is repainted, once for the whole batch:
+// the frames are composited from the bottom to the top into a back buffer
+// clipped to the union, and the buffer is copied to the root. Frames below
+// one covering all the rectangles are skipped.
+//
+// In the overview (overview.c), the frames are painted as thumbnails
+// instead. Each thumbnail is rendered into a pixmap of its own, which is
+// kept after the overview is closed, and rendered again only if the frame
+// has been damaged or resized since. Frames not mapped cannot be rendered,
+// and keep their last thumbnail.
+
+#include <stdlib.h>
+#include <xcb/composite.h>
+#include <xcb/xfixes.h>
+#include "wm0.h"
+#include "compositor.h"
+
+#define MAX_RECTS 64  // Rectangles collected before merging them into one
+
+static bool running;                    // Whether compositing is started
+static xcb_render_pictformat_t format;  // Format of the root visual
+static xcb_render_picture_t root;       // Picture of the root window
+static xcb_pixmap_t buffer_pixmap;      // Back buffer, as large as the screen
+static xcb_render_picture_t buffer;     // Picture of the back buffer, or 0
+static uint16_t buffer_w, buffer_h;     // Size of the back buffer
+static xcb_xfixes_region_t region;      // Region to repaint
+
+static xcb_rectangle_t rects[MAX_RECTS];  // Rectangles to repaint
+static int nrects;
+static struct {
+    int x1, y1, x2, y2;
+} bounds;                    // Bounding box of the rectangles
+static struct window *dirty; // Windows with damage not acknowledged yet
+static bool overview;        // Whether the overview is shown
+
+// Hash table of the windows by XID of the frame, for the damage events.
+// Slots are probed linearly, and removal shifts the following entries back,
+// so that no tombstone is left.
+static struct window **frames;
+static size_t frames_size;   // Number of slots (power of 2, or 0)
+static size_t frames_count;  // Number of windows
+
+static size_t
+slot(xcb_window_t frame)
+{
+    return (frame * 2654435761u) >> 8 & (frames_size - 1);
+}
+
+// Add the window to the hash table, growing it to keep it half empty.
+// If memory is exhausted, the damage of the window is ignored.
+static void
+frames_insert(struct window *win)
+{
+    size_t i;
+
+    if (2 * (frames_count + 1) > frames_size) {
+        size_t old_size = frames_size, size = old_size ? old_size * 2 : 64;
+        struct window **old = frames, **new = calloc(size, sizeof(*new));
+
+        if (new == NULL)
+            return;
+        frames = new;
+        frames_size = size;
+        for (size_t j = 0; j < old_size; ++j) {
+            if (old[j] == NULL)
+                continue;
+            for (i = slot(old[j]->frame); frames[i] != NULL;
+                i = (i + 1) & (size - 1))
+                ;
+            frames[i] = old[j];
+        }
+        free(old);
+    }
+    for (i = slot(win->frame); frames[i] != NULL;
+        i = (i + 1) & (frames_size - 1))
+        ;
+    frames[i] = win;
+    ++frames_count;
+}
+
+static struct window *
+frames_find(xcb_window_t frame)
+{
+    if (frames_size == 0)
+        return NULL;
+    for (size_t i = slot(frame); frames[i] != NULL;
+        i = (i + 1) & (frames_size - 1)) {
+        if (frames[i]->frame == frame)
+            return frames[i];
+    }
+    return NULL;
+}
+
+static void
+frames_remove(struct window *win)
+{
+    size_t mask = frames_size - 1, i, j;
+
+    if (frames_size == 0)
+        return;
+    for (i = slot(win->frame); frames[i] != win; i = (i + 1) & mask) {
+        if (frames[i] == NULL)
+            return;
+    }
+    // Move back each following entry which cannot be reached from its home
+    // slot once slot i is emptied.
+    for (j = (i + 1) & mask; frames[j] != NULL; j = (j + 1) & mask) {
+        size_t home = slot(frames[j]->frame);
+
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            frames[i] = frames[j];
+            i = j;
+        }
+    }
+    frames[i] = NULL;
+    --frames_count;
+}
+
+// Add the rectangle to the area to repaint.
+static void
+expose(int x, int y, int w, int h)
+{
+    if (w <= 0 || h <= 0)
+        return;
+    if (nrects == 0) {
+        bounds.x1 = x;
+        bounds.y1 = y;
+        bounds.x2 = x + w;
+        bounds.y2 = y + h;
+    } else {
+        bounds.x1 = MIN(bounds.x1, x);
+        bounds.y1 = MIN(bounds.y1, y);
+        bounds.x2 = MAX(bounds.x2, x + w);
+        bounds.y2 = MAX(bounds.y2, y + h);
+    }
+
+    // Many small rectangles cost more than repainting their bounding box.
+    if (nrects == MAX_RECTS) {
+        rects[0] = (xcb_rectangle_t) {
+            bounds.x1, bounds.y1, bounds.x2 - bounds.x1, bounds.y2 - bounds.y1
+        };
+        nrects = 1;
+        return;
+    }
+    rects[nrects++] = (xcb_rectangle_t) { x, y, w, h };
+}
+
+// Add the area of the frame, including its border, to the area to repaint.
+static void
+expose_window(const struct window *win)
+{
+    expose(win->x, win->y, win->w + 2 * win->bw, win->h + 2 * win->bw);
+}
+
+// Add the area of the thumbnail of the window to the area to repaint.
+static void
+expose_thumbnail(const struct window *win)
+{
+    expose(win->comp.thumb.x, win->comp.thumb.y, win->comp.thumb.w,
+        win->comp.thumb.h);
+}
+
+// Free the thumbnail of the window.
+static void
+release_thumbnail(struct window *win)
+{
+    if (win->comp.thumb.picture == XCB_NONE)
+        return;
+    xcb_render_free_picture(wm.conn, win->comp.thumb.picture);
+    xcb_free_pixmap(wm.conn, win->comp.thumb.pixmap);
+    win->comp.thumb.picture = win->comp.thumb.pixmap = XCB_NONE;
+}
+
+// Forget the contents of the frame. The server allocates a new pixmap
+// whenever the frame is mapped or resized, so it is named again when
+// painted next time.
+static void
+release(struct window *win)
+{
+    if (win->comp.picture == XCB_NONE)
+        return;
+    xcb_render_free_picture(wm.conn, win->comp.picture);
+    xcb_free_pixmap(wm.conn, win->comp.pixmap);
+    win->comp.picture = win->comp.pixmap = XCB_NONE;
+}
+
+// Start compositing the frames added afterwards.
+// format must be the one of the root visual, which all frames have.
+void
+compositor_start(xcb_render_pictformat_t pictformat)
+{
+    format = pictformat;
+
+    // The root is clipped by its children not redirected, i.e. the
+    // override-redirect windows, which are drawn by the server.
+    root = xcb_generate_id(wm.conn);
+    xcb_render_create_picture(wm.conn, root, wm.screen->root, format, 0,
+        NULL);
+    region = xcb_generate_id(wm.conn);
+    xcb_xfixes_create_region(wm.conn, region, 0, NULL);
+    buffer = XCB_NONE;
+    buffer_w = buffer_h = 0;
+    nrects = 0;
+    dirty = NULL;
+    overview = false;
+    running = true;
+}
+
+// Stop compositing. This is called after all windows are unmanaged, so the
+// frames are already destroyed.
+void
+compositor_stop(void)
+{
+    if (!running)
+        return;
+    if (buffer != XCB_NONE) {
+        xcb_render_free_picture(wm.conn, buffer);
+        xcb_free_pixmap(wm.conn, buffer_pixmap);
+    }
+    xcb_render_free_picture(wm.conn, root);
+    xcb_xfixes_destroy_region(wm.conn, region);
+
+    // Let the server repaint the root, since the windows are drawn by the
+    // server again.
+    xcb_clear_area(wm.conn, false, wm.screen->root, 0, 0, 0, 0);
+    free(frames);
+    frames = NULL;
+    frames_size = frames_count = 0;
+    running = false;
+}
+
+// Redirect the frame of the new window, and watch its contents.
+// The damage is freed by the server with the frame.
+void
+compositor_add(struct window *win)
+{
+    win->comp.damage = XCB_NONE;
+    win->comp.pixmap = XCB_NONE;
+    win->comp.picture = XCB_NONE;
+    win->comp.mapped = false;
+    win->comp.dirty = false;
+    win->comp.next_dirty = NULL;
+    win->comp.thumb.pixmap = XCB_NONE;
+    win->comp.thumb.picture = XCB_NONE;
+    win->comp.thumb.shown = false;
+    if (!running)
+        return;
+
+    xcb_composite_redirect_window(wm.conn, win->frame,
+        XCB_COMPOSITE_REDIRECT_MANUAL);
+    win->comp.damage = xcb_generate_id(wm.conn);
+    xcb_damage_create(wm.conn, win->comp.damage, win->frame,
+        XCB_DAMAGE_REPORT_LEVEL_DELTA_RECTANGLES);
+    frames_insert(win);
+}
+
+// Forget the window, before its frame is destroyed.
+void
+compositor_remove(struct window *win)
+{
+    struct window **p;
+
+    if (!running || win->comp.damage == XCB_NONE)
+        return;
+    if (win->comp.mapped)
+        expose_window(win);
+    if (win->comp.thumb.shown)
+        expose_thumbnail(win);
+    release(win);
+    release_thumbnail(win);
+    if (win->comp.dirty) {
+        for (p = &dirty; *p != win; p = &(*p)->comp.next_dirty)
+            ;
+        *p = win->comp.next_dirty;
+    }
+    frames_remove(win);
+}
+
+// The frame was mapped or unmapped.
+void
+compositor_map(struct window *win, bool mapped)
+{
+    if (!running || win->comp.damage == XCB_NONE)
+        return;
+    win->comp.mapped = mapped;
+    release(win);
+    expose_window(win);
+}
+
+// The frame was moved or resized from the geometry in old.
+void
+compositor_update(struct window *win, const struct window *old)
+{
+    if (!running)
+        return;
+    if (win->w != old->w || win->h != old->h || win->bw != old->bw) {
+        release(win);
+        win->comp.thumb.stale = true;
+    }
+    if (win->comp.mapped) {
+        expose_window(old);
+        expose_window(win);
+    }
+}
+
+// The frame was restacked.
+void
+compositor_expose(struct window *win)
+{
+    if (running && win->comp.mapped)
+        expose_window(win);
+}
+
+// DamageNotify reports an area of the frame drawn by the server or the
+// client. The area is relative to the inside of the border.
+void
+compositor_damage(xcb_damage_notify_event_t *ev)
+{
+    struct window *win;
+
+    if (!running || (win = frames_find(ev->drawable)) == NULL)
+        return;
+    win->comp.thumb.stale = true;
+    if (overview && win->comp.thumb.shown) {
+        expose_thumbnail(win);
+    } else if (win->comp.mapped) {
+        expose(win->x + win->bw + ev->area.x, win->y + win->bw + ev->area.y,
+            ev->area.width, ev->area.height);
+    }
+    if (!win->comp.dirty) {
+        win->comp.dirty = true;
+        win->comp.next_dirty = dirty;
+        dirty = win;
+    }
+}
+
+// Expose reports an area of the root drawn over by the server, e.g. where a
+// window not redirected (override-redirect) was unmapped.
+void
+compositor_expose_root(xcb_expose_event_t *ev)
+{
+    if (running)
+        expose(ev->x, ev->y, ev->width, ev->height);
+}
+
+// Show or hide the overview. The windows are put into the overview by
+// compositor_thumbnail().
+void
+compositor_overview(bool shown)
+{
+    struct window *win;
+
+    if (!running)
+        return;
+    overview = shown;
+    if (!shown) {
+        for (win = window_bottom(); win != NULL;
+            win = TAILQ_NEXT(win, stack_link))
+            win->comp.thumb.shown = false;
+    }
+    expose(0, 0, wm.screen->width_in_pixels, wm.screen->height_in_pixels);
+}
+
+// Show the thumbnail of the window in the overview, in the given area.
+// The cached thumbnail is kept if its size is not changed.
+void
+compositor_thumbnail(struct window *win, int16_t x, int16_t y, uint16_t w,
+    uint16_t h)
+{
+    if (!running || win->comp.damage == XCB_NONE)
+        return;
+    if (win->comp.thumb.picture == XCB_NONE || w != win->comp.thumb.w ||
+        h != win->comp.thumb.h) {
+        release_thumbnail(win);
+        win->comp.thumb.stale = true;
+    }
+    win->comp.thumb.x = x;
+    win->comp.thumb.y = y;
+    win->comp.thumb.w = w;
+    win->comp.thumb.h = h;
+    win->comp.thumb.shown = true;
+}
+
+// Make the back buffer as large as the screen, and repaint all of it.
+static void
+resize_buffer(void)
+{
+    if (buffer != XCB_NONE) {
+        xcb_render_free_picture(wm.conn, buffer);
+        xcb_free_pixmap(wm.conn, buffer_pixmap);
+    }
+    buffer_w = wm.screen->width_in_pixels;
+    buffer_h = wm.screen->height_in_pixels;
+    buffer_pixmap = xcb_generate_id(wm.conn);
+    xcb_create_pixmap(wm.conn, wm.screen->root_depth, buffer_pixmap,
+        wm.screen->root, buffer_w, buffer_h);
+    buffer = xcb_generate_id(wm.conn);
+    xcb_render_create_picture(wm.conn, buffer, buffer_pixmap, format, 0,
+        NULL);
+    expose(0, 0, buffer_w, buffer_h);
+}
+
+static bool
+covers(const struct window *win)
+{
+    return win->x <= bounds.x1 && win->y <= bounds.y1 &&
+        win->x + win->w + 2 * win->bw >= bounds.x2 &&
+        win->y + win->h + 2 * win->bw >= bounds.y2;
+}
+
+static bool
+intersects(const struct window *win)
+{
+    return win->x < bounds.x2 && win->y < bounds.y2 &&
+        win->x + win->w + 2 * win->bw > bounds.x1 &&
+        win->y + win->h + 2 * win->bw > bounds.y1;
+}
+
+// Name the contents of the frame, unless it has been named.
+static void
+name_window(struct window *win)
+{
+    if (win->comp.picture != XCB_NONE)
+        return;
+    win->comp.pixmap = xcb_generate_id(wm.conn);
+    xcb_composite_name_window_pixmap(wm.conn, win->frame, win->comp.pixmap);
+    win->comp.picture = xcb_generate_id(wm.conn);
+    xcb_render_create_picture(wm.conn, win->comp.picture, win->comp.pixmap,
+        format, 0, NULL);
+}
+
+// Composite the contents of the frame, including its border, into the back
+// buffer.
+static void
+paint_window(struct window *win)
+{
+    name_window(win);
+    xcb_render_composite(wm.conn, XCB_RENDER_PICT_OP_SRC, win->comp.picture,
+        XCB_NONE, buffer, 0, 0, 0, 0, win->x, win->y,
+        win->w + 2 * win->bw, win->h + 2 * win->bw);
+}
+
+// Render the thumbnail by scaling down the contents of the frame, which must
+// be mapped. The transform of the picture of the frame maps the thumbnail to
+// the frame, and is reset afterwards for painting the frame as it is.
+static void
+render_thumbnail(struct window *win)
+{
+    static const char filter[] = "bilinear";
+    static const xcb_render_transform_t identity = {
+        1 << 16, 0, 0, 0, 1 << 16, 0, 0, 0, 1 << 16
+    };
+    int w = win->w + 2 * win->bw, h = win->h + 2 * win->bw;
+
+    if (win->comp.thumb.picture == XCB_NONE) {
+        win->comp.thumb.pixmap = xcb_generate_id(wm.conn);
+        xcb_create_pixmap(wm.conn, wm.screen->root_depth,
+            win->comp.thumb.pixmap, wm.screen->root, win->comp.thumb.w,
+            win->comp.thumb.h);
+        win->comp.thumb.picture = xcb_generate_id(wm.conn);
+        xcb_render_create_picture(wm.conn, win->comp.thumb.picture,
+            win->comp.thumb.pixmap, format, 0, NULL);
+    }
+    name_window(win);
+    xcb_render_set_picture_filter(wm.conn, win->comp.picture,
+        sizeof(filter) - 1, filter, 0, NULL);
+    xcb_render_set_picture_transform(wm.conn, win->comp.picture,
+        (xcb_render_transform_t) {
+            ((int64_t)w << 16) / win->comp.thumb.w, 0, 0,
+            0, ((int64_t)h << 16) / win->comp.thumb.h, 0,
+            0, 0, 1 << 16
+        });
+    xcb_render_composite(wm.conn, XCB_RENDER_PICT_OP_SRC, win->comp.picture,
+        XCB_NONE, win->comp.thumb.picture, 0, 0, 0, 0, 0, 0,
+        win->comp.thumb.w, win->comp.thumb.h);
+    xcb_render_set_picture_transform(wm.conn, win->comp.picture, identity);
+    win->comp.thumb.stale = false;
+}
+
+// Paint the frames as they are, from the topmost one covering everything to
+// repaint. Without such a frame, the background is painted first.
+static void
+paint_desktop(const xcb_rectangle_t *box)
+{
+    struct window *win;
+
+    for (win = window_top(); win != NULL;
+        win = TAILQ_PREV(win, window_stack, stack_link)) {
+        if (win->comp.mapped && covers(win))
+            break;
+    }
+    if (win == NULL) {
+        xcb_render_fill_rectangles(wm.conn, XCB_RENDER_PICT_OP_SRC, buffer,
+            (xcb_render_color_t) { 0, 0, 0, 0xffff }, 1, box);
+        win = window_bottom();
+    }
+    for (; win != NULL; win = TAILQ_NEXT(win, stack_link)) {
+        if (win->comp.mapped && intersects(win))
+            paint_window(win);
+    }
+}
+
+// Paint the thumbnails on the background, rendering the stale ones again.
+// Windows without a thumbnail are shown as gray boxes.
+static void
+paint_overview(const xcb_rectangle_t *box)
+{
+    struct window *win;
+
+    xcb_render_fill_rectangles(wm.conn, XCB_RENDER_PICT_OP_SRC, buffer,
+        (xcb_render_color_t) { 0x2000, 0x2000, 0x2000, 0xffff }, 1, box);
+    for (win = window_bottom(); win != NULL;
+        win = TAILQ_NEXT(win, stack_link)) {
+        xcb_rectangle_t r = {
+            win->comp.thumb.x, win->comp.thumb.y,
+            win->comp.thumb.w, win->comp.thumb.h
+        };
+
+        if (!win->comp.thumb.shown || r.x >= bounds.x2 || r.y >= bounds.y2 ||
+            r.x + r.width <= bounds.x1 || r.y + r.height <= bounds.y1)
+            continue;
+        if (win->comp.mapped && (win->comp.thumb.picture == XCB_NONE ||
+            win->comp.thumb.stale))
+            render_thumbnail(win);
+        if (win->comp.thumb.picture != XCB_NONE) {
+            xcb_render_composite(wm.conn, XCB_RENDER_PICT_OP_SRC,
+                win->comp.thumb.picture, XCB_NONE, buffer, 0, 0, 0, 0, r.x,
+                r.y, r.width, r.height);
+        } else {
+            xcb_render_fill_rectangles(wm.conn, XCB_RENDER_PICT_OP_SRC,
+                buffer, (xcb_render_color_t) { 0x8000, 0x8000, 0x8000, 0xffff },
+                1, &r);
+        }
+    }
+}
+
+// Repaint the area collected since the last call.
+// This is called when the event loop runs out of events.
+void
+compositor_paint(void)
+{
+    struct window *win;
+    xcb_rectangle_t box;
+
+    if (!running)
+        return;
+
+    // Acknowledge the damage, so that the areas drawn again are reported.
+    while ((win = dirty) != NULL) {
+        xcb_damage_subtract(wm.conn, win->comp.damage, XCB_NONE, XCB_NONE);
+        win->comp.dirty = false;
+        dirty = win->comp.next_dirty;
+    }
+
+    if (buffer == XCB_NONE || buffer_w != wm.screen->width_in_pixels ||
+        buffer_h != wm.screen->height_in_pixels)
+        resize_buffer();
+    if (nrects == 0)
+        return;
+
+    box = (xcb_rectangle_t) {
+        bounds.x1, bounds.y1, bounds.x2 - bounds.x1, bounds.y2 - bounds.y1
+    };
+    xcb_xfixes_set_region(wm.conn, region, nrects, rects);
+    xcb_xfixes_set_picture_clip_region(wm.conn, buffer, region, 0, 0);
+    if (overview)
+        paint_overview(&box);
+    else
+        paint_desktop(&box);
+
+    xcb_xfixes_set_picture_clip_region(wm.conn, root, region, 0, 0);
+    xcb_render_composite(wm.conn, XCB_RENDER_PICT_OP_SRC, buffer, XCB_NONE,
+        root, box.x, box.y, 0, 0, box.x, box.y, box.width, box.height);
+    nrects = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef WM0_COMPOSITOR_H
+#define WM0_COMPOSITOR_H
+
+#include <stdbool.h>
+#include <xcb/render.h>
+#include <xcb/damage.h>
+#include "window.h"
+
+void compositor_start(xcb_render_pictformat_t format);
+void compositor_stop(void);
+void compositor_add(struct window *win);
+void compositor_remove(struct window *win);
+void compositor_map(struct window *win, bool mapped);
+void compositor_update(struct window *win, const struct window *old);
+void compositor_expose(struct window *win);
+void compositor_damage(xcb_damage_notify_event_t *ev);
+void compositor_expose_root(xcb_expose_event_t *ev);
+void compositor_overview(bool shown);
+void compositor_thumbnail(struct window *win, int16_t x, int16_t y,
+    uint16_t w, uint16_t h);
+void compositor_paint(void);
+
+#endif // WM0_COMPOSITOR_H
@@ -0,0 +1,333 @@
+// Configuration file parser.
+//
+// The configuration file consists of lines of "key value", and rules
+// (see rules.c). Empty lines and lines starting with '#' are ignored.
+
+#include <ctype.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <xcb/xcb.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "config.h"
+#include "wm0.h"
+#include "rules.h"
+#include "tile.h"
+
+static bool parse_button(const char *value, void *dst);
+static bool parse_modkey(const char *value, void *dst);
+static bool parse_color(const char *value, void *dst);
+static bool parse_level(const char *value, void *dst);
+static bool parse_distance(const char *value, void *dst);
+static bool parse_layout(const char *value, void *dst);
+static bool parse_percent(const char *value, void *dst);
+static const char *conf_path(void);
+#ifdef __linux__
+static bool watch_dir(int fd, char *dir);
+
+static int parent_wd = -1;  // Watch of the parent of the directory, or -1
+#endif
+
+// Table of the configuration keys.
+static const struct {
+    const char *name;
+    bool (*parse)(const char *value, void *dst);
+    size_t offset;
+} keys[] = {
+    { "button_move",    parse_button,   offsetof(struct conf, button_move) },
+    { "button_resize",  parse_button,   offsetof(struct conf, button_resize) },
+    { "button_close",   parse_button,   offsetof(struct conf, button_close) },
+    { "modkey",         parse_modkey,   offsetof(struct conf, modkey) },
+    { "color_active",   parse_color,    offsetof(struct conf, color_active) },
+    { "color_inactive", parse_color,    offsetof(struct conf, color_inactive) },
+    { "log_level",      parse_level,    offsetof(struct conf, log_level) },
+    { "snap_distance",  parse_distance, offsetof(struct conf, snap_distance) },
+    { "layout",         parse_layout,   offsetof(struct conf, layout) },
+    { "master_size",    parse_percent,  offsetof(struct conf, master_size) },
+};
+
+// Table of the modifier names.
+static const struct {
+    const char *name;
+    uint16_t mask;
+} modifiers[] = {
+    { "shift",   XCB_MOD_MASK_SHIFT },
+    { "control", XCB_MOD_MASK_CONTROL },
+    { "mod1",    XCB_MOD_MASK_1 },
+    { "mod2",    XCB_MOD_MASK_2 },
+    { "mod3",    XCB_MOD_MASK_3 },
+    { "mod4",    XCB_MOD_MASK_4 },
+    { "mod5",    XCB_MOD_MASK_5 },
+};
+
+// Parse a mouse button number (1-5).
+static bool
+parse_button(const char *value, void *dst)
+{
+    if (value[0] < '1' || value[0] > '5' || value[1] != '\0')
+        return false;
+    *(uint8_t *)dst = value[0] - '0';
+    return true;
+}
+
+// Parse a modifier name.
+static bool
+parse_modkey(const char *value, void *dst)
+{
+    for (int i = 0; i < LENGTH(modifiers); ++i) {
+        if (strcmp(value, modifiers[i].name) == 0) {
+            *(uint16_t *)dst = modifiers[i].mask;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse a color (#RRGGBB).
+static bool
+parse_color(const char *value, void *dst)
+{
+    if (value[0] != '#' || strlen(value) != 7)
+        return false;
+    for (int i = 1; i < 7; ++i) {
+        if (!isxdigit((unsigned char)value[i]))
+            return false;
+    }
+    memcpy(dst, value, 8);
+    return true;
+}
+
+// Parse a log level.
+static bool
+parse_level(const char *value, void *dst)
+{
+    static const char *levels[] = {
+        [LOG_NONE] = "none", [LOG_INFO] = "info", [LOG_DEBUG] = "debug"
+    };
+
+    for (int i = 0; i < LENGTH(levels); ++i) {
+        if (strcmp(value, levels[i]) == 0) {
+            *(uint8_t *)dst = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse a distance in pixels (0-1000).
+static bool
+parse_distance(const char *value, void *dst)
+{
+    char *end;
+    long n = strtol(value, &end, 10);
+
+    if (end == value || *end != '\0' || n < 0 || n > 1000)
+        return false;
+    *(uint16_t *)dst = n;
+    return true;
+}
+
+// Parse a layout name.
+static bool
+parse_layout(const char *value, void *dst)
+{
+    static const char *layouts[] = {
+        [LAYOUT_FLOAT] = "float", [LAYOUT_MASTER] = "master",
+        [LAYOUT_GRID] = "grid"
+    };
+
+    for (int i = 0; i < LENGTH(layouts); ++i) {
+        if (strcmp(value, layouts[i]) == 0) {
+            *(uint8_t *)dst = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse a percentage (10-90).
+static bool
+parse_percent(const char *value, void *dst)
+{
+    char *end;
+    long n = strtol(value, &end, 10);
+
+    if (end == value || *end != '\0' || n < 10 || n > 90)
+        return false;
+    *(uint8_t *)dst = n;
+    return true;
+}
+
+// Get the path of the configuration file.
+// CONFIG_FILE is relative to $XDG_CONFIG_HOME (default: $HOME/.config).
+static const char *
+conf_path(void)
+{
+    static char path[PATH_MAX];
+    const char *base, *home;
+
+    if (path[0] != '\0')
+        return path;
+
+    if ((base = getenv("XDG_CONFIG_HOME")) != NULL && base[0] != '\0')
+        snprintf(path, sizeof(path), "%s/%s", base, CONFIG_FILE);
+    else if ((home = getenv("HOME")) != NULL)
+        snprintf(path, sizeof(path), "%s/.config/%s", home, CONFIG_FILE);
+    return path;
+}
+
+// Set the default values in config.h.
+void
+conf_default(struct conf *conf)
+{
+    conf->button_move = BUTTON_MOVE;
+    conf->button_resize = BUTTON_RESIZE;
+    conf->button_close = BUTTON_CLOSE;
+    conf->modkey = MODKEY_MASK;
+    strcpy(conf->color_active, COLOR_ACTIVE);
+    strcpy(conf->color_inactive, COLOR_INACTIVE);
+    conf->log_level = LOG_LEVEL;
+    conf->snap_distance = SNAP_DISTANCE;
+    conf->layout = LAYOUT;
+    conf->master_size = MASTER_SIZE;
+}
+
+// Load the configuration file.
+// Keys not in the file are reset to the default values.
+void
+conf_load(struct conf *conf)
+{
+    FILE *fp;
+    char line[256];
+    int lineno = 0;
+
+    conf_default(conf);
+    rules_clear();
+    if (conf_path()[0] == '\0' || (fp = fopen(conf_path(), "r")) == NULL)
+        return;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *key, *value;
+        int i;
+
+        ++lineno;
+        key = strtok(line, " \t\r\n");
+        if (key == NULL || key[0] == '#')
+            continue;
+        if (strcmp(key, "rule") == 0) {
+            if ((value = strtok(NULL, "\r\n")) == NULL || !rules_parse(value))
+                fprintf(stderr, "%s:%d: invalid rule\n", conf_path(), lineno);
+            continue;
+        }
+        value = strtok(NULL, " \t\r\n");
+
+        for (i = 0; i < LENGTH(keys); ++i) {
+            if (strcmp(key, keys[i].name) == 0)
+                break;
+        }
+        if (i == LENGTH(keys) || value == NULL ||
+            !keys[i].parse(value, (char *)conf + keys[i].offset)) {
+            fprintf(stderr, "%s:%d: invalid line\n", conf_path(), lineno);
+        }
+    }
+    fclose(fp);
+    rules_compile();
+}
+
+// Start watching the configuration file, and return a file descriptor which
+// becomes readable when the file may have been changed.
+// The directory is watched instead of the file itself, because editors
+// often replace the file by renaming a new one. If the directory does not
+// exist yet, its parent is watched until it is created (see conf_changed).
+int
+conf_watch(void)
+{
+#ifdef __linux__
+    char dir[PATH_MAX];
+    char *p;
+    int fd;
+
+    strcpy(dir, conf_path());
+    if ((p = strrchr(dir, '/')) == NULL)
+        return -1;
+    *p = '\0';
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (!watch_dir(fd, dir)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+#ifdef __linux__
+// Watch the directory, or its parent for the directory to be created.
+static bool
+watch_dir(int fd, char *dir)
+{
+    char *p;
+
+    if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE)
+            >= 0) {
+        parent_wd = -1;
+        return true;
+    }
+    if ((p = strrchr(dir, '/')) == NULL || p == dir)
+        return false;
+    *p = '\0';
+    parent_wd = inotify_add_watch(fd, dir, IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+    return parent_wd >= 0;
+}
+#endif
+
+// Read pending notifications from the file descriptor returned by
+// conf_watch(), and check if the configuration file was changed.
+// When the directory of the file is created, it is watched instead of its
+// parent, and the file is taken as changed if it is already there.
+bool
+conf_changed(int fd)
+{
+#ifdef __linux__
+    char buf[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *name = strrchr(conf_path(), '/') + 1;
+    char dir[PATH_MAX];
+    bool changed = false, created = false;
+    ssize_t len;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+
+            if (ev->wd == parent_wd)
+                created = true;
+            else if (ev->len > 0 && strcmp(ev->name, name) == 0)
+                changed = true;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    if (created) {
+        strcpy(dir, conf_path());
+        *strrchr(dir, '/') = '\0';
+        if (inotify_add_watch(fd, dir,
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) >= 0) {
+            inotify_rm_watch(fd, parent_wd);
+            parent_wd = -1;
+            changed = access(conf_path(), R_OK) == 0;
+        }
+    }
+    return changed;
+#else
+    return false;
+#endif
+}
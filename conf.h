@@ -0,0 +1,28 @@
+#ifndef WM0_CONF_H
+#define WM0_CONF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Runtime configuration.
+// Each member starts with the default value in config.h, and can be
+// overridden by the configuration file.
+struct conf {
+    uint8_t button_move;     // Mouse button to move a window
+    uint8_t button_resize;   // Mouse button to resize a window
+    uint8_t button_close;    // Mouse button to close a window
+    uint16_t modkey;         // Modifier key mask
+    char color_active[8];    // Border color of active window (#RRGGBB)
+    char color_inactive[8];  // Border color of inactive windows (#RRGGBB)
+    uint8_t log_level;       // Log level (LOG_*)
+    uint16_t snap_distance;  // Distance to snap to edges (0 = disabled)
+    uint8_t layout;          // Layout of the desktops (LAYOUT_*)
+    uint8_t master_size;     // Width of the master window (percent)
+};
+
+void conf_default(struct conf *conf);
+void conf_load(struct conf *conf);
+int conf_watch(void);
+bool conf_changed(int fd);
+
+#endif // WM0_CONF_H
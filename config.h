@@ -1,6 +1,12 @@
 #ifndef WM0_CONFIG_H
 #define WM0_CONFIG_H
 
+// Default values of the configuration.
+// These can be overridden by the configuration file (see README).
+
+// Path of the configuration file (relative to $XDG_CONFIG_HOME)
+#define CONFIG_FILE "wm0/config"
+
 // Mouse button assignment (1 = left, 2 = middle, 3 = right)
 #define BUTTON_MOVE    1
 #define BUTTON_RESIZE  3
@@ -13,4 +19,20 @@
 #define COLOR_ACTIVE   "#0000FF"  // for active (focused) window
 #define COLOR_INACTIVE "#202020"  // for inactive (not focused) window
 
+// Distance within which dragged windows snap to the edges of the screen and
+// other windows (pixels, 0 to disable)
+#define SNAP_DISTANCE 10
+
+// Layout of the desktops (LAYOUT_FLOAT, LAYOUT_MASTER or LAYOUT_GRID), and
+// the width of the master window in LAYOUT_MASTER (percent of the monitor)
+#define LAYOUT      LAYOUT_FLOAT
+#define MASTER_SIZE 55
+
+// Log level (LOG_NONE, LOG_INFO or LOG_DEBUG)
+#ifdef DEBUG
+#define LOG_LEVEL LOG_DEBUG
+#else
+#define LOG_LEVEL LOG_NONE
+#endif
+
 #endif // WM0_CONFIG_H
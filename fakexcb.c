@@ -0,0 +1,338 @@
+// Fake of libxcb.
+//
+// Only the functions used by the WM are implemented. Requests are not sent
+// anywhere, but recorded to the history.
+
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+#include <xcb/sync.h>
+#include <xcb/composite.h>
+#include <xcb/damage.h>
+#include <xcb/xfixes.h>
+#include <xcb/render.h>
+#include "fakexcb.h"
+
+#define HISTORY_SIZE 1024  // Number of requests kept in the history
+
+struct fake_stats fake_stats;
+void *(*fake_reply_hook)(unsigned int sequence);
+bool (*fake_poll_hook)(unsigned int sequence);
+
+static unsigned int sequence;  // Sequence number of the last request
+static unsigned int synced;    // Last request known to be processed
+static uint32_t last_id;       // Last XID allocated by xcb_generate_id()
+static struct fake_request history[HISTORY_SIZE];  // Recent requests
+
+// Scripted replies
+static struct {
+    uint8_t opcode;
+    void *reply;
+} *script;
+static size_t script_head, script_len, script_size;
+
+// Issue a request, and return its sequence number.
+static unsigned int
+request(uint8_t opcode, uint32_t window)
+{
+    struct fake_request *r = &history[++sequence % HISTORY_SIZE];
+
+    r->sequence = sequence;
+    r->opcode = opcode;
+    r->window = window;
+    ++fake_stats.requests;
+    return sequence;
+}
+
+// Look up the reply for the request.
+static void *
+lookup(unsigned int sequence, xcb_generic_error_t **e)
+{
+    const struct fake_request *r = fake_request(sequence);
+
+    if (e != NULL)
+        *e = NULL;
+
+    if (script_head < script_len) {
+        if (r != NULL && script[script_head].opcode == r->opcode)
+            return script[script_head++].reply;
+        ++fake_stats.unexpected;
+        return NULL;
+    }
+    if (fake_reply_hook != NULL)
+        return fake_reply_hook(sequence);
+    ++fake_stats.unexpected;
+    return NULL;
+}
+
+// Wait for the reply for the request.
+static void *
+reply(unsigned int sequence, xcb_generic_error_t **e)
+{
+    // Waiting for a reply flushes all the requests issued so far, so the
+    // replies for them can be received without another round trip.
+    if (sequence > synced) {
+        ++fake_stats.round_trips;
+        synced = fake_sequence();
+    }
+    return lookup(sequence, e);
+}
+
+// Clear the statistics, the history and the script.
+void
+fake_reset(void)
+{
+    while (script_head < script_len)
+        free(script[script_head++].reply);
+    script_head = script_len = 0;
+    memset(&fake_stats, 0, sizeof(fake_stats));
+    memset(history, 0, sizeof(history));
+    synced = sequence;
+}
+
+// Append a reply to the script.
+// Replies are returned in the order they are appended, for requests of the
+// given opcode.
+void
+fake_push_reply(uint8_t opcode, const void *reply, size_t length)
+{
+    if (script_head == script_len)
+        script_head = script_len = 0;
+    if (script_len == script_size) {
+        script_size = script_size ? script_size * 2 : 64;
+        script = realloc(script, script_size * sizeof(*script));
+        if (script == NULL)
+            abort();
+    }
+    script[script_len].opcode = opcode;
+    script[script_len].reply = malloc(length);
+    if (script[script_len].reply == NULL)
+        abort();
+    memcpy(script[script_len++].reply, reply, length);
+}
+
+// Get the request with the given sequence number from the history.
+// Return NULL if it is too old.
+const struct fake_request *
+fake_request(unsigned int sequence)
+{
+    const struct fake_request *r = &history[sequence % HISTORY_SIZE];
+
+    return r->sequence == sequence && sequence != 0 ? r : NULL;
+}
+
+// Get the sequence number of the last request.
+unsigned int
+fake_sequence(void)
+{
+    return sequence;
+}
+
+// Define a request without reply.
+#define VOID_REQUEST(name, opcode, window, ...) \
+    xcb_void_cookie_t \
+    xcb_ ## name(xcb_connection_t *c, __VA_ARGS__) \
+    { \
+        return (xcb_void_cookie_t) { request(opcode, window) }; \
+    }
+
+// Define a request with reply, and the function to get its reply.
+#define REPLY_REQUEST(name, opcode, window, ...) \
+    xcb_ ## name ## _cookie_t \
+    xcb_ ## name(xcb_connection_t *c, __VA_ARGS__) \
+    { \
+        return (xcb_ ## name ## _cookie_t) { request(opcode, window) }; \
+    } \
+    \
+    xcb_ ## name ## _cookie_t \
+    xcb_ ## name ## _unchecked(xcb_connection_t *c, __VA_ARGS__) \
+    { \
+        return (xcb_ ## name ## _cookie_t) { request(opcode, window) }; \
+    } \
+    \
+    xcb_ ## name ## _reply_t * \
+    xcb_ ## name ## _reply(xcb_connection_t *c, \
+        xcb_ ## name ## _cookie_t cookie, xcb_generic_error_t **e) \
+    { \
+        return reply(cookie.sequence, e); \
+    }
+
+VOID_REQUEST(change_window_attributes, XCB_CHANGE_WINDOW_ATTRIBUTES, window,
+    xcb_window_t window, uint32_t value_mask, const void *value_list)
+VOID_REQUEST(map_window, XCB_MAP_WINDOW, window,
+    xcb_window_t window)
+VOID_REQUEST(unmap_window, XCB_UNMAP_WINDOW, window,
+    xcb_window_t window)
+VOID_REQUEST(configure_window, XCB_CONFIGURE_WINDOW, window,
+    xcb_window_t window, uint16_t value_mask, const void *value_list)
+VOID_REQUEST(change_property, XCB_CHANGE_PROPERTY, window,
+    uint8_t mode, xcb_window_t window, xcb_atom_t property, xcb_atom_t type,
+    uint8_t format, uint32_t data_len, const void *data)
+VOID_REQUEST(ungrab_pointer, XCB_UNGRAB_POINTER, XCB_NONE,
+    xcb_timestamp_t time)
+VOID_REQUEST(grab_button, XCB_GRAB_BUTTON, grab_window,
+    uint8_t owner_events, xcb_window_t grab_window, uint16_t event_mask,
+    uint8_t pointer_mode, uint8_t keyboard_mode, xcb_window_t confine_to,
+    xcb_cursor_t cursor, uint8_t button, uint16_t modifiers)
+VOID_REQUEST(ungrab_button, XCB_UNGRAB_BUTTON, grab_window,
+    uint8_t button, xcb_window_t grab_window, uint16_t modifiers)
+VOID_REQUEST(allow_events, XCB_ALLOW_EVENTS, XCB_NONE,
+    uint8_t mode, xcb_timestamp_t time)
+VOID_REQUEST(set_input_focus, XCB_SET_INPUT_FOCUS, focus,
+    uint8_t revert_to, xcb_window_t focus, xcb_timestamp_t time)
+VOID_REQUEST(kill_client, XCB_KILL_CLIENT, resource,
+    uint32_t resource)
+VOID_REQUEST(send_event, XCB_SEND_EVENT, destination,
+    uint8_t propagate, xcb_window_t destination, uint32_t event_mask,
+    const char *event)
+VOID_REQUEST(create_window, XCB_CREATE_WINDOW, wid,
+    uint8_t depth, xcb_window_t wid, xcb_window_t parent, int16_t x, int16_t y,
+    uint16_t width, uint16_t height, uint16_t border_width, uint16_t _class,
+    xcb_visualid_t visual, uint32_t value_mask, const void *value_list)
+VOID_REQUEST(destroy_window, XCB_DESTROY_WINDOW, window,
+    xcb_window_t window)
+VOID_REQUEST(reparent_window, XCB_REPARENT_WINDOW, window,
+    xcb_window_t window, xcb_window_t parent, int16_t x, int16_t y)
+VOID_REQUEST(change_save_set, XCB_CHANGE_SAVE_SET, window,
+    uint8_t mode, xcb_window_t window)
+VOID_REQUEST(create_pixmap, XCB_CREATE_PIXMAP, pid,
+    uint8_t depth, xcb_pixmap_t pid, xcb_drawable_t drawable, uint16_t width,
+    uint16_t height)
+VOID_REQUEST(free_pixmap, XCB_FREE_PIXMAP, pixmap,
+    xcb_pixmap_t pixmap)
+VOID_REQUEST(clear_area, XCB_CLEAR_AREA, window,
+    uint8_t exposures, xcb_window_t window, int16_t x, int16_t y,
+    uint16_t width, uint16_t height)
+VOID_REQUEST(sync_create_alarm, FAKE_SYNC_OPCODE, id,
+    xcb_sync_alarm_t id, uint32_t value_mask, const void *value_list)
+VOID_REQUEST(sync_change_alarm, FAKE_SYNC_OPCODE, id,
+    xcb_sync_alarm_t id, uint32_t value_mask, const void *value_list)
+VOID_REQUEST(sync_destroy_alarm, FAKE_SYNC_OPCODE, alarm,
+    xcb_sync_alarm_t alarm)
+VOID_REQUEST(composite_redirect_window, FAKE_COMPOSITE_OPCODE, window,
+    xcb_window_t window, uint8_t update)
+VOID_REQUEST(composite_name_window_pixmap, FAKE_COMPOSITE_OPCODE, window,
+    xcb_window_t window, xcb_pixmap_t pixmap)
+VOID_REQUEST(damage_create, FAKE_DAMAGE_OPCODE, drawable,
+    xcb_damage_damage_t damage, xcb_drawable_t drawable, uint8_t level)
+VOID_REQUEST(damage_subtract, FAKE_DAMAGE_OPCODE, damage,
+    xcb_damage_damage_t damage, xcb_xfixes_region_t repair,
+    xcb_xfixes_region_t parts)
+VOID_REQUEST(xfixes_create_region, FAKE_XFIXES_OPCODE, region,
+    xcb_xfixes_region_t region, uint32_t rectangles_len,
+    const xcb_rectangle_t *rectangles)
+VOID_REQUEST(xfixes_set_region, FAKE_XFIXES_OPCODE, region,
+    xcb_xfixes_region_t region, uint32_t rectangles_len,
+    const xcb_rectangle_t *rectangles)
+VOID_REQUEST(xfixes_destroy_region, FAKE_XFIXES_OPCODE, region,
+    xcb_xfixes_region_t region)
+VOID_REQUEST(xfixes_set_picture_clip_region, FAKE_XFIXES_OPCODE, picture,
+    xcb_render_picture_t picture, xcb_xfixes_region_t region,
+    int16_t x_origin, int16_t y_origin)
+VOID_REQUEST(render_create_picture, FAKE_RENDER_OPCODE, pid,
+    xcb_render_picture_t pid, xcb_drawable_t drawable,
+    xcb_render_pictformat_t format, uint32_t value_mask,
+    const void *value_list)
+VOID_REQUEST(render_free_picture, FAKE_RENDER_OPCODE, picture,
+    xcb_render_picture_t picture)
+VOID_REQUEST(render_composite, FAKE_RENDER_OPCODE, dst,
+    uint8_t op, xcb_render_picture_t src, xcb_render_picture_t mask,
+    xcb_render_picture_t dst, int16_t src_x, int16_t src_y, int16_t mask_x,
+    int16_t mask_y, int16_t dst_x, int16_t dst_y, uint16_t width,
+    uint16_t height)
+VOID_REQUEST(render_fill_rectangles, FAKE_RENDER_OPCODE, dst,
+    uint8_t op, xcb_render_picture_t dst, xcb_render_color_t color,
+    uint32_t rects_len, const xcb_rectangle_t *rects)
+VOID_REQUEST(render_set_picture_transform, FAKE_RENDER_OPCODE, picture,
+    xcb_render_picture_t picture, xcb_render_transform_t transform)
+VOID_REQUEST(render_set_picture_filter, FAKE_RENDER_OPCODE, picture,
+    xcb_render_picture_t picture, uint16_t filter_len, const char *filter,
+    uint32_t values_len, const xcb_render_fixed_t *values)
+
+REPLY_REQUEST(get_window_attributes, XCB_GET_WINDOW_ATTRIBUTES, window,
+    xcb_window_t window)
+REPLY_REQUEST(get_geometry, XCB_GET_GEOMETRY, drawable,
+    xcb_drawable_t drawable)
+REPLY_REQUEST(query_tree, XCB_QUERY_TREE, window,
+    xcb_window_t window)
+REPLY_REQUEST(grab_pointer, XCB_GRAB_POINTER, grab_window,
+    uint8_t owner_events, xcb_window_t grab_window, uint16_t event_mask,
+    uint8_t pointer_mode, uint8_t keyboard_mode, xcb_window_t confine_to,
+    xcb_cursor_t cursor, xcb_timestamp_t time)
+REPLY_REQUEST(get_property, XCB_GET_PROPERTY, window,
+    uint8_t _delete, xcb_window_t window, xcb_atom_t property,
+    xcb_atom_t type, uint32_t long_offset, uint32_t long_length)
+
+xcb_window_t *
+xcb_query_tree_children(const xcb_query_tree_reply_t *R)
+{
+    return (xcb_window_t *)(R + 1);
+}
+
+int
+xcb_query_tree_children_length(const xcb_query_tree_reply_t *R)
+{
+    return R->children_len;
+}
+
+void *
+xcb_get_property_value(const xcb_get_property_reply_t *R)
+{
+    return (void *)(R + 1);
+}
+
+int
+xcb_get_property_value_length(const xcb_get_property_reply_t *R)
+{
+    return R->value_len * (R->format / 8);
+}
+
+// XIDs are allocated from a range no real client uses.
+uint32_t
+xcb_generate_id(xcb_connection_t *c)
+{
+    return 0xf0000000 | ++last_id;
+}
+
+// Replies are available without blocking, unless fake_poll_hook tells
+// otherwise.
+int
+xcb_poll_for_reply(xcb_connection_t *c, unsigned int request, void **reply,
+    xcb_generic_error_t **error)
+{
+    if (fake_poll_hook != NULL && !fake_poll_hook(request))
+        return 0;
+    *reply = lookup(request, error);
+    return 1;
+}
+
+void
+xcb_discard_reply(xcb_connection_t *c, unsigned int sequence)
+{
+}
+
+int
+xcb_flush(xcb_connection_t *c)
+{
+    return 1;
+}
+
+// These are from xcb-util.
+
+const char *
+xcb_event_get_request_label(uint8_t type)
+{
+    return "(request)";
+}
+
+const char *
+xcb_event_get_error_label(uint8_t type)
+{
+    return "(error)";
+}
+
+const char *
+xcb_event_get_label(uint8_t type)
+{
+    return "(event)";
+}
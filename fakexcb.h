@@ -0,0 +1,51 @@
+#ifndef WM0_FAKEXCB_H
+#define WM0_FAKEXCB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fake of libxcb, which is linked instead of libxcb to run the handlers
+// without the X server.
+//
+// Requests issued by the WM are recorded, and replies are taken from the
+// script (see fake_push_reply()), or fake_reply_hook if the script is empty.
+
+// Major opcodes of the requests of extensions in the history
+// (opcodes of extensions are assigned by the server)
+#define FAKE_SYNC_OPCODE      128
+#define FAKE_COMPOSITE_OPCODE 129
+#define FAKE_DAMAGE_OPCODE    130
+#define FAKE_XFIXES_OPCODE    131
+#define FAKE_RENDER_OPCODE    132
+
+// Request issued by the WM
+struct fake_request {
+    unsigned int sequence;  // Sequence number
+    uint8_t opcode;         // Major opcode (XCB_CONFIGURE_WINDOW etc.)
+    uint32_t window;        // Window (or other resource) of the request
+};
+
+// Statistics of the requests
+struct fake_stats {
+    unsigned long requests;     // Number of requests issued
+    unsigned long round_trips;  // Number of times the WM blocked for replies
+    unsigned long unexpected;   // Number of replies not found in the script
+};
+
+extern struct fake_stats fake_stats;
+
+// Function to get the reply for the request with the given sequence number.
+// The reply must be allocated by malloc(), or NULL if the request failed.
+extern void *(*fake_reply_hook)(unsigned int sequence);
+
+// Function to tell whether the reply for the request has arrived, for
+// xcb_poll_for_reply(). If NULL, replies are always available.
+extern bool (*fake_poll_hook)(unsigned int sequence);
+
+void fake_reset(void);
+void fake_push_reply(uint8_t opcode, const void *reply, size_t length);
+const struct fake_request *fake_request(unsigned int sequence);
+unsigned int fake_sequence(void);
+
+#endif // WM0_FAKEXCB_H
@@ -1,9 +1,37 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <xcb/xcbext.h>     // for xcb_poll_for_reply
+#include <xcb/xcb_event.h>  // for xcb_event_* and XCB_EVENT_RESPONSE_TYPE
+#include <xcb/sync.h>
+#include <xcb/randr.h>
+#include <xcb/damage.h>
 #include "wm0.h"
 #include "window.h"
+#include "monitor.h"
+#include "snap.h"
+#include "compositor.h"
+#include "overview.h"
+#include "tile.h"
+#include "places.h"
+
+// Time to wait for a client to redraw after resize (ms)
+// Clients not responding in time are resized without waiting.
+#define SYNC_TIMEOUT 100
 
 static void start_pointer_grab(int mode, int16_t x, int16_t y);
+static bool check_pointer_grab(void);
 static void stop_pointer_grab(void);
+static bool resize_pending(xcb_timestamp_t time);
+static void drag(int16_t x, int16_t y, xcb_timestamp_t time);
+static void drag_buffered(void);
+
+// Call the handler between the probes <handler>_entry and <handler>_return
+// (see probe.h).
+#define CALL(handler, event) do { \
+    PROBE1(handler ## _entry, event); \
+    handler((void *)(event)); \
+    PROBE(handler ## _return); \
+} while (0)
 
 // MapRequest indicates that a client sent a MapWindow request.
 // When this function is called, the window is not mapped, so WM should map it.
@@ -13,16 +41,31 @@ handle_map_request(xcb_map_request_event_t *ev)
     struct window *win;
     xcb_get_window_attributes_reply_t *r;
 
-    LOG("MapRequest on %x\n", ev->window);
+    LOG(MSG_MAP_REQUEST, ev->window);
+
+    // An iconified window or a window on another desktop asks to be shown.
+    // Restore it and bring it to the current desktop, without managing it
+    // again.
+    if ((win = window_find(ev->window)) != NULL) {
+        window_restore(win);
+        window_send_to_desktop(win, wm.desktop);
+        window_focus(win);
+        return;
+    }
 
     // Windows with override_redirect flag is not handled by non-compositing WM.
     r = XCB_REQUEST_AND_REPLY(wm.conn, get_window_attributes, NULL, ev->window);
     if (r != NULL) {
         if (!r->override_redirect) {
-            win = window_manage(ev->window);
-            if (win != NULL) {
-                xcb_map_window(wm.conn, win->id);
-                window_focus(win);
+            win = window_manage(ev->window, r, true);
+            // Rules may put the window on another desktop, or keep it from
+            // being focused.
+            if (win != NULL && win->desktop == wm.desktop) {
+                // Lay out the window before it is shown.
+                tile_arrange(wm.desktop);
+                window_map(win);
+                if (win->focus)
+                    window_focus(win);
             }
         }
     }
@@ -30,7 +73,7 @@ handle_map_request(xcb_map_request_event_t *ev)
     // If we fail to manage the window, map it so that the user can access the
     // window even in that case.
     if (r == NULL || (!r->override_redirect && win == NULL))
-        xcb_map_window(wm.conn, ev->window);
+        XCB_SEND(wm.conn, map_window, ev->window, ev->window);
 
     free(r);
 }
@@ -41,11 +84,26 @@ handle_unmap_notify(xcb_unmap_notify_event_t *ev)
 {
     struct window *win;
 
-    LOG("UnmapNotify on %x\n", ev->window);
+    LOG(MSG_UNMAP_NOTIFY, ev->window);
 
     win = window_find(ev->window);
-    if (win != NULL)
-        window_unmanage(win);
+    if (win == NULL)
+        return;
+
+    // The window in a frame is reported to the frame. The one reported to the
+    // root is caused by reparenting the window into the frame.
+    if (win->frame != win->id && ev->event != win->frame &&
+        !(ev->response_type & 0x80))
+        return;
+
+    // Ignore the window unmapped by the WM itself (see window_unmap()).
+    // A synthetic UnmapNotify is sent by the client to withdraw the window
+    // which is already unmapped, e.g. iconified (ICCCM 4.1.4).
+    if (win->ignore_unmap > 0 && !(ev->response_type & 0x80)) {
+        --win->ignore_unmap;
+        return;
+    }
+    window_unmanage(win, false);
 }
 
 // DestroyNotify indicates that a window was destroyed.
@@ -54,11 +112,11 @@ handle_destroy_notify(xcb_destroy_notify_event_t *ev)
 {
     struct window *win;
 
-    LOG("DestroyNotify on %x\n", ev->window);
+    LOG(MSG_DESTROY_NOTIFY, ev->window);
 
     win = window_find(ev->window);
     if (win != NULL)
-        window_unmanage(win);
+        window_unmanage(win, true);
 }
 
 // ConfigureRequest indicates that a client sent a ConfigureWindow request.
@@ -67,10 +125,17 @@ handle_destroy_notify(xcb_destroy_notify_event_t *ev)
 void
 handle_configure_request(xcb_configure_request_event_t *ev)
 {
+    struct window *win;
     uint32_t values[6];
     int i = 0;
 
-    LOG("ConfigureRequest on %x\n", ev->window);
+    LOG(MSG_CONFIGURE_REQUEST, ev->window);
+
+    win = window_find(ev->window);
+    if (win != NULL && (win->frame != win->id || tile_fixed(win))) {
+        window_configure(win, ev);
+        return;
+    }
 
     // We need to handle ConfigureRequest from unmanaged windows (i.e. unmapped
     // windows), because some clients configure window before mapping it.
@@ -91,66 +156,211 @@ handle_configure_request(xcb_configure_request_event_t *ev)
         values[i++] = ev->sibling;
     if (ev->value_mask & XCB_CONFIG_WINDOW_STACK_MODE)
         values[i++] = ev->stack_mode;
-    xcb_configure_window(wm.conn, ev->window, ev->value_mask, values);
+    XCB_SEND(wm.conn, configure_window, ev->window, ev->window,
+        ev->value_mask, values);
+
+    // Keep the geometry of the managed window up to date.
+    if (win != NULL) {
+        struct window old = *win;
+
+        if (ev->value_mask & XCB_CONFIG_WINDOW_X)
+            win->x = ev->x;
+        if (ev->value_mask & XCB_CONFIG_WINDOW_Y)
+            win->y = ev->y;
+        if (ev->value_mask & XCB_CONFIG_WINDOW_WIDTH)
+            win->w = ev->width;
+        if (ev->value_mask & XCB_CONFIG_WINDOW_HEIGHT)
+            win->h = ev->height;
+        if (ev->value_mask & XCB_CONFIG_WINDOW_BORDER_WIDTH)
+            win->bw = ev->border_width;
+        snap_update(win, &old);
+    }
+}
+
+// ClientMessage indicates that a client sent a message to the WM.
+void
+handle_client_message(xcb_client_message_event_t *ev)
+{
+    struct window *win;
+
+    LOG(MSG_CLIENT_MESSAGE, ev->window, ev->type);
+
+    // WM_CHANGE_STATE with IconicState asks to iconify the window (ICCCM
+    // 4.1.4). Restoring is asked by MapWindow instead.
+    if (ev->type == wm.atoms.wm_change_state && ev->format == 32 &&
+        ev->data.data32[0] == WM_STATE_ICONIC) {
+        if ((win = window_find(ev->window)) != NULL)
+            window_iconify(win);
+    }
+}
+
+// PropertyNotify indicates that a property of a window was changed.
+void
+handle_property_notify(xcb_property_notify_event_t *ev)
+{
+    struct window *win;
+
+    // Other properties (e.g. WM_NAME) change often, so they are filtered
+    // out before looking up the window.
+    if (ev->atom == XCB_ATOM_WM_NORMAL_HINTS) {
+        if ((win = window_find(ev->window)) != NULL)
+            window_update_hints(win);
+    } else if (ev->atom == wm.atoms.wm_protocols ||
+        ev->atom == wm.atoms.net_wm_sync_request_counter) {
+        if ((win = window_find(ev->window)) != NULL)
+            window_update_sync(win);
+    }
 }
 
 // Establish an active grab of the mouse to intercept all mouse events
 // (MotionNotify and ButtonRelease).
+// We do not wait for the reply here, since the pointer is frozen by the
+// passive grab until xcb_allow_events() is sent. The grab is assumed to
+// succeed, and the reply is checked by check_pointer_grab() later.
 static void
 start_pointer_grab(int mode, int16_t x, int16_t y)
 {
-    xcb_grab_pointer_reply_t *r;
+    struct window *win = window_get_current();
 
     wm.grab.mode = mode;
     wm.grab.x = x;
     wm.grab.y = y;
+    wm.grab.win_x = win->x;
+    wm.grab.win_y = win->y;
+    wm.grab.win_w = win->w;
+    wm.grab.win_h = win->h;
+    wm.grab.buffered = false;
 
-    r = XCB_REQUEST_AND_REPLY(wm.conn, grab_pointer, NULL, false,
+    wm.grab.sequence = xcb_grab_pointer(wm.conn, false,
         wm.screen->root, XCB_EVENT_MASK_BUTTON_RELEASE |
         XCB_EVENT_MASK_POINTER_MOTION, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
-        wm.screen->root, XCB_NONE, XCB_CURRENT_TIME);
-    if (r == NULL)
+        wm.screen->root, XCB_NONE, XCB_CURRENT_TIME).sequence;
+}
+
+// Check the reply of the grab started by start_pointer_grab(), if it has
+// arrived.
+// Return true if the grab is known to be established.
+static bool
+check_pointer_grab(void)
+{
+    xcb_grab_pointer_reply_t *r;
+    xcb_generic_error_t *e;
+
+    if (wm.grab.sequence == 0)
+        return true;
+    if (!xcb_poll_for_reply(wm.conn, wm.grab.sequence, (void **)&r, &e))
+        return false;  // The reply has not arrived yet.
+
+    wm.grab.sequence = 0;
+    trace_reply(r);
+    if (r == NULL || r->status != XCB_GRAB_STATUS_SUCCESS) {
+        LOG(MSG_GRAB_FAILED, 0);
         wm.grab.mode = NO_GRAB;
+        free(r);
+        free(e);
+        return false;
+    }
     free(r);
+
+    // Apply the motion received before the reply.
+    drag_buffered();
+    return true;
 }
 
 // Stop an active grab of the mouse.
 static void
 stop_pointer_grab()
 {
+    if (wm.grab.sequence != 0) {
+        xcb_discard_reply(wm.conn, wm.grab.sequence);
+        wm.grab.sequence = 0;
+    }
     xcb_ungrab_pointer(wm.conn, XCB_CURRENT_TIME);
     wm.grab.mode = NO_GRAB;
 }
 
+// Check whether the current window is still being redrawn by the client
+// after the last resize (_NET_WM_SYNC_REQUEST).
+// Sending another resize meanwhile only makes the client lag behind, so
+// motions are buffered until AlarmNotify.
+static bool
+resize_pending(xcb_timestamp_t time)
+{
+    struct window *win = window_get_current();
+
+    if (wm.grab.mode != GRAB_RESIZE || !win->sync.waiting)
+        return false;
+    if (time - wm.grab.time < SYNC_TIMEOUT)
+        return true;
+    win->sync.waiting = false;
+    return false;
+}
+
+// Move or resize the current window as the pointer moved to (x, y).
+// The geometry is computed from the start of the drag rather than from the
+// previous motion, so that the pointer stays at the same position relative to
+// the window even if the size is rounded by the size hints.
+static void
+drag(int16_t x, int16_t y, xcb_timestamp_t time)
+{
+    struct window *win = window_get_current();
+    int dx, dy;
+
+    dx = x - wm.grab.x;
+    dy = y - wm.grab.y;
+
+    if (wm.grab.mode == GRAB_MOVE) {
+        int wx = wm.grab.win_x + dx, wy = wm.grab.win_y + dy;
+
+        snap_move(win, &wx, &wy);
+        window_move(win, wx, wy);
+    } else {
+        int w = MAX(wm.grab.win_w + dx, 1), h = MAX(wm.grab.win_h + dy, 1);
+
+        snap_resize(win, &w, &h);
+        window_resize(win, w, h);
+        wm.grab.time = time;
+    }
+}
+
+// Apply the buffered motion, if any.
+static void
+drag_buffered(void)
+{
+    if (wm.grab.buffered) {
+        wm.grab.buffered = false;
+        drag(wm.grab.buffered_x, wm.grab.buffered_y, wm.grab.buffered_time);
+    }
+}
+
 // ButtonPress indicates that the mouse button was pressed.
 void
 handle_button_press(xcb_button_press_event_t *ev)
 {
     struct window *win;
 
-    LOG("ButtonPress on %x, modifier=%x, button=%x\n", ev->event, ev->state,
-        ev->detail);
+    LOG(MSG_BUTTON_PRESS, ev->event, ev->state, ev->detail);
+
+    if (overview_click(ev))
+        return;
 
     win = window_find(ev->event);
     if (win != NULL) {
         window_raise(win);
         window_focus(win);
 
-        if (ev->state & MODKEY_MASK) {
-            int mode;
+        if (ev->state & wm.conf.modkey) {
+            int mode = NO_GRAB;
 
-            switch (ev->detail) {
-            case BUTTON_MOVE:
+            // Buttons are configurable at runtime, so we cannot use switch.
+            if (ev->detail == wm.conf.button_move)
                 mode = GRAB_MOVE;
-                break;
-            case BUTTON_RESIZE:
+            else if (ev->detail == wm.conf.button_resize)
                 mode = GRAB_RESIZE;
-                break;
-            case BUTTON_CLOSE:
-                mode = NO_GRAB;
+            else if (ev->detail == wm.conf.button_close)
                 window_close(win);
-            }
-            if (mode != NO_GRAB)
+            // Tiled windows are laid out by tile.c, and cannot be dragged.
+            if (mode != NO_GRAB && !tile_fixed(win))
                 start_pointer_grab(mode, ev->root_x, ev->root_y);
         }
         xcb_allow_events(wm.conn, XCB_ALLOW_REPLAY_POINTER, XCB_CURRENT_TIME);
@@ -161,29 +371,250 @@ handle_button_press(xcb_button_press_event_t *ev)
 void
 handle_button_release(xcb_button_release_event_t *ev)
 {
-    LOG("ButtonRelease on %x\n", ev->event);
+    LOG(MSG_BUTTON_RELEASE, ev->event);
 
-    if (wm.grab.mode != NO_GRAB)
+    if (wm.grab.mode != NO_GRAB) {
+        // Apply the last motion even if the client is still redrawing, so
+        // that the window ends up with the size the user chose.
+        if (wm.grab.sequence == 0)
+            drag_buffered();
+        // The position is remembered only when the drag ends (see places.c).
+        if (wm.grab.mode == GRAB_MOVE && window_get_current() != NULL) {
+            window_notify_moved(window_get_current());
+            places_store(window_get_current());
+        }
         stop_pointer_grab();
+    }
+}
+
+// KeyPress indicates that a key grabbed on the root window was pressed.
+// Modkey + number switches to the desktop, and Modkey + Shift + number moves
+// the current window to the desktop. Modkey + Tab toggles the overview, and
+// Modkey + Space cycles the layout of the current desktop.
+void
+handle_key_press(xcb_key_press_event_t *ev)
+{
+    struct window *win = window_get_current();
+
+    LOG(MSG_KEY_PRESS, ev->event, ev->state, ev->detail);
+
+    // Do not hide the window being dragged.
+    if (wm.grab.mode != NO_GRAB)
+        return;
+
+    if (wm.overview_key != 0 && ev->detail == wm.overview_key) {
+        overview_toggle();
+        return;
+    }
+    if (wm.layout_key != 0 && ev->detail == wm.layout_key) {
+        tile_set_layout(wm.desktop,
+            (tile_get_layout(wm.desktop) + 1) % LAYOUTS);
+        return;
+    }
+    for (int i = 0; i < DESKTOPS; ++i) {
+        if (wm.keycodes[i] == 0 || ev->detail != wm.keycodes[i])
+            continue;
+        overview_close();
+        if (!(ev->state & XCB_MOD_MASK_SHIFT))
+            window_switch_desktop(i);
+        else if (win != NULL)
+            window_send_to_desktop(win, i);
+        return;
+    }
 }
 
 // MotionNotify indicates that the mouse pointer was moved.
 void
 handle_motion_notify(xcb_motion_notify_event_t *ev)
 {
-    if (wm.grab.mode != NO_GRAB) {
-        struct window *win = window_get_current();
-        int16_t dx, dy;
+    if (wm.grab.mode == NO_GRAB)
+        return;
+
+    if (!check_pointer_grab() || resize_pending(ev->time)) {
+        // Until the grab is confirmed or the client redraws the window, keep
+        // only the latest position, since motions are relative to the start
+        // of the drag.
+        if (wm.grab.mode != NO_GRAB) {
+            wm.grab.buffered = true;
+            wm.grab.buffered_x = ev->root_x;
+            wm.grab.buffered_y = ev->root_y;
+            wm.grab.buffered_time = ev->time;
+        }
+        return;
+    }
+    drag(ev->root_x, ev->root_y, ev->time);
+}
+
+// AlarmNotify (XSync) indicates that a client updated its counter, i.e. it
+// has redrawn the window after the last resize.
+void
+handle_alarm_notify(xcb_sync_alarm_notify_event_t *ev)
+{
+    struct window *win = window_get_current();
+
+    // Only the current window is resized by the user.
+    if (win == NULL || win->sync.alarm != ev->alarm)
+        return;
+
+    win->sync.waiting = false;
+    if (wm.grab.mode == GRAB_RESIZE && wm.grab.sequence == 0)
+        drag_buffered();
+}
+
+// RRScreenChangeNotify indicates that the size of the screen changed.
+void
+handle_screen_change_notify(xcb_randr_screen_change_notify_event_t *ev)
+{
+    // The size is before the rotation.
+    if (ev->rotation & (XCB_RANDR_ROTATION_ROTATE_90 |
+        XCB_RANDR_ROTATION_ROTATE_270))
+        monitor_resize_screen(ev->height, ev->width);
+    else
+        monitor_resize_screen(ev->width, ev->height);
+    tile_arrange(wm.desktop);
+}
+
+// RRNotify (CrtcChange) indicates that a CRTC was enabled, disabled, moved or
+// resized.
+void
+handle_randr_notify(xcb_randr_notify_event_t *ev)
+{
+    xcb_randr_crtc_change_t *cc = &ev->u.cc;
+
+    if (ev->subCode != XCB_RANDR_NOTIFY_CRTC_CHANGE)
+        return;
+    LOG(MSG_MONITOR, cc->crtc, cc->width, cc->height);
+
+    if (cc->mode == XCB_NONE)
+        monitor_update(cc->crtc, 0, 0, 0, 0);
+    else
+        monitor_update(cc->crtc, cc->x, cc->y, cc->width, cc->height);
+    tile_arrange(wm.desktop);
+}
 
-        dx = ev->root_x - wm.grab.x;
-        dy = ev->root_y - wm.grab.y;
+// DamageNotify indicates that a frame was drawn, while compositing.
+// It is repainted with the other damage after the batch of events.
+void
+handle_damage_notify(xcb_damage_notify_event_t *ev)
+{
+    compositor_damage(ev);
+}
 
-        if (wm.grab.mode == GRAB_MOVE)
-            window_move(win, win->x + dx, win->y + dy);
-        else
-            window_resize(win, win->w + dx, win->h + dy);
+// Expose indicates that an area of the root must be painted again, while
+// compositing. It is repainted with the other damage after the batch of
+// events.
+void
+handle_expose(xcb_expose_event_t *ev)
+{
+    compositor_expose_root(ev);
+}
 
-        wm.grab.x = ev->root_x;
-        wm.grab.y = ev->root_y;
+// Get the window which the event is about, for the events handled by the WM,
+// or 0.
+xcb_window_t
+handle_event_window(const xcb_generic_event_t *event)
+{
+    switch (XCB_EVENT_RESPONSE_TYPE(event)) {
+    case XCB_MAP_REQUEST:
+        return ((xcb_map_request_event_t *)event)->window;
+    case XCB_UNMAP_NOTIFY:
+        return ((xcb_unmap_notify_event_t *)event)->window;
+    case XCB_DESTROY_NOTIFY:
+        return ((xcb_destroy_notify_event_t *)event)->window;
+    case XCB_CONFIGURE_REQUEST:
+        return ((xcb_configure_request_event_t *)event)->window;
+    case XCB_PROPERTY_NOTIFY:
+        return ((xcb_property_notify_event_t *)event)->window;
+    case XCB_CLIENT_MESSAGE:
+        return ((xcb_client_message_event_t *)event)->window;
+    case XCB_BUTTON_PRESS:
+    case XCB_BUTTON_RELEASE:
+    case XCB_KEY_PRESS:
+    case XCB_MOTION_NOTIFY:
+        // These have the same layout.
+        return ((xcb_button_press_event_t *)event)->event;
+    default:
+        return XCB_NONE;
     }
 }
+
+// Dispatch the event (or the error) to the appropriate function.
+void
+handle_event(xcb_generic_event_t *event)
+{
+    if (event->response_type == 0) {
+        xcb_generic_error_t *e = (xcb_generic_error_t *)event;
+        const struct origin *o = origin_find(e->full_sequence);
+
+        // We ignore BadWindow error, since it is sometimes not avoidable.
+        // The window we operate can be unmapped or destroyed by its owner
+        // process, just after we send a request about it, which results in
+        // a BadWindow error. It is only counted for the owner of the window
+        // (rather than of the frame, which is ours), and logged.
+        if (e->error_code == XCB_WINDOW) {
+            account_bad_window(o != NULL ? o->window : e->resource_id);
+            if (o != NULL)
+                LOG(MSG_STALE, o->window, e->major_code, o->handler);
+            return;
+        }
+        fprintf(stderr, "X protocol error: request=%s, error=%s",
+            xcb_event_get_request_label(e->major_code),
+            xcb_event_get_error_label(e->error_code));
+        if (o != NULL) {
+            const char *label = o->handler == 0 ? "nothing" :
+                xcb_event_get_label(o->handler);
+
+            fprintf(stderr, ", sent as %s on 0x%x", o->request, o->window);
+            // Events of extensions have no label.
+            if (label != NULL)
+                fprintf(stderr, " while handling %s", label);
+            else
+                fprintf(stderr, " while handling event %u", o->handler);
+        }
+        fputc('\n', stderr);
+        return;
+    }
+
+    // Events of extensions have no fixed type, and cannot be in the switch.
+    if (wm.sync_event != 0 &&
+        XCB_EVENT_RESPONSE_TYPE(event) == wm.sync_event + XCB_SYNC_ALARM_NOTIFY) {
+        CALL(handle_alarm_notify, event);
+        return;
+    }
+    if (wm.randr_event != 0) {
+        switch (XCB_EVENT_RESPONSE_TYPE(event) - wm.randr_event) {
+        case XCB_RANDR_SCREEN_CHANGE_NOTIFY:
+            CALL(handle_screen_change_notify, event);
+            return;
+        case XCB_RANDR_NOTIFY:
+            CALL(handle_randr_notify, event);
+            return;
+        }
+    }
+    if (wm.damage_event != 0 &&
+        XCB_EVENT_RESPONSE_TYPE(event) == wm.damage_event + XCB_DAMAGE_NOTIFY) {
+        CALL(handle_damage_notify, event);
+        return;
+    }
+
+#define HANDLE_EVENT(type, handler) case type: CALL(handler, event); break
+
+    switch (XCB_EVENT_RESPONSE_TYPE(event)) {
+        HANDLE_EVENT(XCB_MAP_REQUEST, handle_map_request);
+        HANDLE_EVENT(XCB_UNMAP_NOTIFY, handle_unmap_notify);
+        HANDLE_EVENT(XCB_DESTROY_NOTIFY, handle_destroy_notify);
+        HANDLE_EVENT(XCB_CONFIGURE_REQUEST, handle_configure_request);
+        HANDLE_EVENT(XCB_PROPERTY_NOTIFY, handle_property_notify);
+        HANDLE_EVENT(XCB_CLIENT_MESSAGE, handle_client_message);
+        HANDLE_EVENT(XCB_BUTTON_PRESS, handle_button_press);
+        HANDLE_EVENT(XCB_BUTTON_RELEASE, handle_button_release);
+        HANDLE_EVENT(XCB_KEY_PRESS, handle_key_press);
+        HANDLE_EVENT(XCB_MOTION_NOTIFY, handle_motion_notify);
+        HANDLE_EVENT(XCB_EXPOSE, handle_expose);
+    }
+
+#undef HANDLE_EVENT
+
+    // Lay out what the event has changed (see tile.c).
+    tile_arrange(wm.desktop);
+}
@@ -0,0 +1,157 @@
+// I/O thread (enabled by `wm0 -i`).
+//
+// A dedicated thread blocks in xcb_wait_for_event(), so reading and decoding
+// events from the socket overlaps with the handlers. Events are handed over
+// to the event loop by a lock-free single-producer/single-consumer ring
+// buffer of pointers, which is allocated in advance. The event loop is woken
+// up through a pipe only when it may have found the ring buffer empty.
+//
+// Replies are still received by the event loop itself: libxcb allows
+// xcb_*_reply() while another thread waits for events.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "io.h"
+
+#define RING_SIZE 1024  // Number of events in the ring buffer
+#define FULL_WAIT 100   // Interval of retrying when the ring is full (us)
+
+static xcb_generic_event_t *ring[RING_SIZE];
+static atomic_uint head;  // Next event to write (by the thread)
+static atomic_uint tail;  // Next event to read (by the event loop)
+static atomic_bool stop;  // Whether the thread should stop
+static int wakeup[2] = { -1, -1 };  // Pipe to wake up the event loop
+static xcb_connection_t *connection;
+static pthread_t thread;
+static bool running;
+
+// Wake up the event loop.
+static void
+wake(void)
+{
+    // If the pipe is full, the event loop is already going to wake up.
+    (void)write(wakeup[1], "", 1);
+}
+
+// Append an event to the ring buffer.
+// If it is full, wait for the event loop, rather than dropping the event.
+static void
+push(xcb_generic_event_t *event)
+{
+    const struct timespec interval = { 0, FULL_WAIT * 1000L };
+    unsigned int h = atomic_load_explicit(&head, memory_order_relaxed);
+
+    while (h - atomic_load(&tail) == RING_SIZE) {
+        if (atomic_load_explicit(&stop, memory_order_relaxed)) {
+            free(event);
+            return;
+        }
+        nanosleep(&interval, NULL);
+    }
+    ring[h % RING_SIZE] = event;
+    atomic_store(&head, h + 1);
+
+    // If the event loop has taken all the previous events, it may have seen
+    // the ring buffer empty and be going to sleep. Both this load and the
+    // store of tail by the event loop are sequentially consistent, so either
+    // of them sees the other.
+    if (atomic_load(&tail) == h)
+        wake();
+}
+
+static void *
+io_thread(void *arg)
+{
+    xcb_generic_event_t *event;
+
+    while ((event = xcb_wait_for_event(connection)) != NULL)
+        push(event);
+
+    // The connection is closed. Wake up the event loop to notice it.
+    wake();
+    return NULL;
+}
+
+// Start the thread to read events from the connection.
+// Return false if it cannot be started; then events should be read by
+// xcb_poll_for_event() as usual.
+bool
+io_start(xcb_connection_t *conn)
+{
+    if (pipe(wakeup) < 0)
+        return false;
+    fcntl(wakeup[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeup[1], F_SETFL, O_NONBLOCK);
+
+    connection = conn;
+    running = pthread_create(&thread, NULL, io_thread, NULL) == 0;
+    if (!running) {
+        close(wakeup[0]);
+        close(wakeup[1]);
+        wakeup[0] = wakeup[1] = -1;
+    }
+    return running;
+}
+
+// Get the file descriptor, which becomes readable when events are available.
+int
+io_fd(void)
+{
+    return wakeup[0];
+}
+
+// Take an event from the ring buffer.
+// Return NULL if it is empty.
+xcb_generic_event_t *
+io_pop(void)
+{
+    unsigned int t = atomic_load_explicit(&tail, memory_order_relaxed);
+    xcb_generic_event_t *event;
+
+    // This load is sequentially consistent, which push() relies on.
+    if (t == atomic_load(&head))
+        return NULL;
+    event = ring[t % RING_SIZE];
+    atomic_store(&tail, t + 1);
+    return event;
+}
+
+// Clear the wake-up notifications, after io_fd() became readable.
+void
+io_clear(void)
+{
+    char buf[64];
+
+    while (read(wakeup[0], buf, sizeof(buf)) > 0)
+        ;
+}
+
+// Stop the thread, and free the events not handled.
+void
+io_stop(void)
+{
+    xcb_generic_event_t *event;
+
+    if (!running)
+        return;
+
+    // Make xcb_wait_for_event() return, if it is still waiting.
+    atomic_store(&stop, true);
+    if (!xcb_connection_has_error(connection))
+        shutdown(xcb_get_file_descriptor(connection), SHUT_RDWR);
+    pthread_join(thread, NULL);
+    running = false;
+
+    while ((event = io_pop()) != NULL)
+        free(event);
+    close(wakeup[0]);
+    close(wakeup[1]);
+    wakeup[0] = wakeup[1] = -1;
+}
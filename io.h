@@ -0,0 +1,13 @@
+#ifndef WM0_IO_H
+#define WM0_IO_H
+
+#include <stdbool.h>
+#include <xcb/xcb.h>
+
+bool io_start(xcb_connection_t *conn);
+int io_fd(void);
+xcb_generic_event_t *io_pop(void);
+void io_clear(void);
+void io_stop(void);
+
+#endif // WM0_IO_H
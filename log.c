@@ -0,0 +1,156 @@
+// Asynchronous logger.
+//
+// The event loop only stores binary records (message, XID, arguments and
+// timestamp) into a lock-free single-producer/single-consumer ring buffer.
+// The records are formatted and written by a background thread, so logging
+// does not block the event loop. If the ring buffer is full, records are
+// dropped rather than waiting for the thread.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include "log.h"
+
+#define RING_SIZE      4096  // Number of records in the ring buffer
+#define DRAIN_INTERVAL 50    // Interval of draining the ring buffer (ms)
+
+struct record {
+    uint64_t time;  // Nanoseconds (CLOCK_MONOTONIC)
+    uint32_t xid;
+    uint32_t a, b;
+    uint16_t msg;
+};
+
+// Formats of the messages. The arguments are XID, a and b.
+static const char *formats[MSG_COUNT] = {
+    [MSG_RELOAD]            = "reload configuration",
+    [MSG_MANAGE]            = "manage %x",
+    [MSG_UNMANAGE]          = "unmanage %x",
+    [MSG_FOCUS]             = "focus %x",
+    [MSG_CLOSE]             = "close %x",
+    [MSG_GRAB_FAILED]       = "failed to grab pointer",
+    [MSG_DESKTOP]           = "switch to desktop %u",
+    [MSG_ICONIFY]           = "iconify %x",
+    [MSG_RESTORE]           = "restore %x",
+    [MSG_MONITOR]           = "CRTC %x changed to %ux%u",
+    [MSG_LAYOUT]            = "layout of desktop %u set to %u",
+    [MSG_STALE]             = "request %2$u on stale window %1$x (event %3$u)",
+    [MSG_MAP_REQUEST]       = "MapRequest on %x",
+    [MSG_UNMAP_NOTIFY]      = "UnmapNotify on %x",
+    [MSG_DESTROY_NOTIFY]    = "DestroyNotify on %x",
+    [MSG_CONFIGURE_REQUEST] = "ConfigureRequest on %x",
+    [MSG_BUTTON_PRESS]      = "ButtonPress on %x, modifier=%x, button=%x",
+    [MSG_BUTTON_RELEASE]    = "ButtonRelease on %x",
+    [MSG_KEY_PRESS]         = "KeyPress on %x, modifier=%x, key=%x",
+    [MSG_CLIENT_MESSAGE]    = "ClientMessage on %x, type=%x",
+};
+
+const uint8_t log_levels[MSG_COUNT] = {
+    [MSG_RELOAD]            = LOG_INFO,
+    [MSG_MANAGE]            = LOG_INFO,
+    [MSG_UNMANAGE]          = LOG_INFO,
+    [MSG_FOCUS]             = LOG_INFO,
+    [MSG_CLOSE]             = LOG_INFO,
+    [MSG_GRAB_FAILED]       = LOG_INFO,
+    [MSG_DESKTOP]           = LOG_INFO,
+    [MSG_ICONIFY]           = LOG_INFO,
+    [MSG_RESTORE]           = LOG_INFO,
+    [MSG_MONITOR]           = LOG_INFO,
+    [MSG_LAYOUT]            = LOG_INFO,
+    [MSG_STALE]             = LOG_DEBUG,
+    [MSG_MAP_REQUEST]       = LOG_DEBUG,
+    [MSG_UNMAP_NOTIFY]      = LOG_DEBUG,
+    [MSG_DESTROY_NOTIFY]    = LOG_DEBUG,
+    [MSG_CONFIGURE_REQUEST] = LOG_DEBUG,
+    [MSG_BUTTON_PRESS]      = LOG_DEBUG,
+    [MSG_BUTTON_RELEASE]    = LOG_DEBUG,
+    [MSG_KEY_PRESS]         = LOG_DEBUG,
+    [MSG_CLIENT_MESSAGE]    = LOG_DEBUG,
+};
+
+static struct record ring[RING_SIZE];
+static atomic_uint head;     // Next record to write (by the event loop)
+static atomic_uint tail;     // Next record to read (by the thread)
+static atomic_uint dropped;  // Number of records dropped
+static atomic_bool stop;     // Whether the thread should stop
+static pthread_t thread;
+static bool running;
+
+// Format and write the records in the ring buffer.
+static void
+drain(void)
+{
+    unsigned int t = atomic_load_explicit(&tail, memory_order_relaxed);
+    unsigned int h = atomic_load_explicit(&head, memory_order_acquire);
+    unsigned int n;
+
+    for (; t != h; ++t) {
+        const struct record *r = &ring[t % RING_SIZE];
+
+        printf("[%5llu.%06llu] ", (unsigned long long)(r->time / 1000000000),
+            (unsigned long long)(r->time / 1000 % 1000000));
+        printf(formats[r->msg], r->xid, r->a, r->b);
+        putchar('\n');
+        atomic_store_explicit(&tail, t + 1, memory_order_release);
+    }
+    if ((n = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed)) > 0)
+        printf("(%u log messages dropped)\n", n);
+    fflush(stdout);
+}
+
+static void *
+drain_thread(void *arg)
+{
+    const struct timespec interval = { 0, DRAIN_INTERVAL * 1000000L };
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        nanosleep(&interval, NULL);
+        drain();
+    }
+    return NULL;
+}
+
+// Start the thread to write the log.
+void
+log_open(void)
+{
+    running = pthread_create(&thread, NULL, drain_thread, NULL) == 0;
+}
+
+// Append a record to the ring buffer.
+// Only a single thread may call this function.
+void
+log_write(int msg, uint32_t xid, uint32_t a, uint32_t b)
+{
+    unsigned int h = atomic_load_explicit(&head, memory_order_relaxed);
+    struct record *r;
+    struct timespec ts;
+
+    if (h - atomic_load_explicit(&tail, memory_order_acquire) == RING_SIZE) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    r = &ring[h % RING_SIZE];
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    r->time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    r->xid = xid;
+    r->a = a;
+    r->b = b;
+    r->msg = msg;
+    atomic_store_explicit(&head, h + 1, memory_order_release);
+}
+
+// Stop the thread, and write the remaining records.
+void
+log_close(void)
+{
+    if (running) {
+        atomic_store(&stop, true);
+        pthread_join(thread, NULL);
+        running = false;
+    }
+    drain();
+}
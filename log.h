@@ -0,0 +1,44 @@
+#ifndef WM0_LOG_H
+#define WM0_LOG_H
+
+#include <stdint.h>
+
+// Log levels
+enum {
+    LOG_NONE,   // Nothing is logged
+    LOG_INFO,   // Operations of the WM
+    LOG_DEBUG   // Every event
+};
+
+// Log messages. Their formats and levels are defined in log.c.
+enum {
+    MSG_RELOAD,
+    MSG_MANAGE,
+    MSG_UNMANAGE,
+    MSG_FOCUS,
+    MSG_CLOSE,
+    MSG_GRAB_FAILED,
+    MSG_DESKTOP,
+    MSG_ICONIFY,
+    MSG_RESTORE,
+    MSG_MONITOR,
+    MSG_LAYOUT,
+    MSG_STALE,
+    MSG_MAP_REQUEST,
+    MSG_UNMAP_NOTIFY,
+    MSG_DESTROY_NOTIFY,
+    MSG_CONFIGURE_REQUEST,
+    MSG_BUTTON_PRESS,
+    MSG_BUTTON_RELEASE,
+    MSG_KEY_PRESS,
+    MSG_CLIENT_MESSAGE,
+    MSG_COUNT
+};
+
+extern const uint8_t log_levels[MSG_COUNT];  // Level of each message
+
+void log_open(void);
+void log_write(int msg, uint32_t xid, uint32_t a, uint32_t b);
+void log_close(void);
+
+#endif // WM0_LOG_H
@@ -0,0 +1,209 @@
+// Table of the monitors.
+//
+// The monitors are fetched from RandR once at startup (wm0.c), and then kept
+// up to date by RRNotify (CrtcChange) and RRScreenChangeNotify events, so
+// that finding the monitor of a point needs no request.
+//
+// To find the monitor at a point in constant time, the screen is divided
+// into a grid by the edges of all the monitors. Each column and row of
+// pixels is mapped to a column and row of the grid, and each cell of the
+// grid to the monitor covering it (or the one nearest to its center, for
+// cells not covered by any monitor). The grid is rebuilt whenever a monitor
+// changes, which is rare.
+
+#include <stdlib.h>
+#include <string.h>
+#include "wm0.h"
+#include "monitor.h"
+
+#define MAX_CELLS (2 * MAX_MONITORS + 1)  // Cells of the grid along each axis
+
+static struct monitor monitors[MAX_MONITORS];
+static int nmonitors;          // Number of monitors, or 0 if not known
+static struct monitor screen;  // Whole screen, used if no monitor is known
+
+static uint8_t *columns, *rows;     // Grid column/row of each pixel
+static uint16_t ncolumns, nrows;    // Width and height of the screen
+static uint8_t cells[MAX_CELLS][MAX_CELLS];  // Monitor of each cell
+
+static int compare(const void *a, const void *b);
+static int split(int *bounds, int limit, bool vertical);
+static int distance(int pos, int start, uint16_t length);
+static bool resize_grid(void);
+static void rebuild(void);
+
+static int
+compare(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+// Collect the edges of the monitors along an axis, clipped to [0, limit].
+// Return the number of the edges, which are sorted and unique.
+static int
+split(int *bounds, int limit, bool vertical)
+{
+    int n = 0, unique = 1;
+
+    bounds[n++] = 0;
+    bounds[n++] = limit;
+    for (int i = 0; i < nmonitors; ++i) {
+        int start = vertical ? monitors[i].y : monitors[i].x;
+        int length = vertical ? monitors[i].h : monitors[i].w;
+
+        bounds[n++] = MAX(0, MIN(start, limit));
+        bounds[n++] = MAX(0, MIN(start + length, limit));
+    }
+    qsort(bounds, n, sizeof(*bounds), compare);
+    for (int i = 1; i < n; ++i) {
+        if (bounds[i] != bounds[unique - 1])
+            bounds[unique++] = bounds[i];
+    }
+    return unique;
+}
+
+// Distance from pos to [start, start + length).
+static int
+distance(int pos, int start, uint16_t length)
+{
+    if (pos < start)
+        return start - pos;
+    if (pos >= start + length)
+        return pos - (start + length - 1);
+    return 0;
+}
+
+// Make the arrays of the columns and rows as large as the screen.
+static bool
+resize_grid(void)
+{
+    uint16_t width = wm.screen->width_in_pixels;
+    uint16_t height = wm.screen->height_in_pixels;
+    uint8_t *p;
+
+    if (width != ncolumns) {
+        if ((p = realloc(columns, width)) == NULL)
+            return false;
+        columns = p;
+        ncolumns = width;
+    }
+    if (height != nrows) {
+        if ((p = realloc(rows, height)) == NULL)
+            return false;
+        rows = p;
+        nrows = height;
+    }
+    return true;
+}
+
+// Rebuild the grid after the monitors or the screen changed.
+static void
+rebuild(void)
+{
+    int xs[2 * MAX_MONITORS + 2], ys[2 * MAX_MONITORS + 2];
+    int nx, ny;
+
+    if (nmonitors == 0 || !resize_grid()) {
+        nmonitors = 0;
+        return;
+    }
+
+    nx = split(xs, ncolumns, false);
+    ny = split(ys, nrows, true);
+    for (int i = 0; i + 1 < nx; ++i)
+        memset(columns + xs[i], i, xs[i + 1] - xs[i]);
+    for (int j = 0; j + 1 < ny; ++j)
+        memset(rows + ys[j], j, ys[j + 1] - ys[j]);
+
+    // No edge runs through a cell, so the monitor covering the center of a
+    // cell covers the whole cell.
+    for (int i = 0; i + 1 < nx; ++i) {
+        for (int j = 0; j + 1 < ny; ++j) {
+            int x = (xs[i] + xs[i + 1]) / 2, y = (ys[j] + ys[j + 1]) / 2;
+            int best = -1, best_distance = 0;
+
+            for (int k = 0; k < nmonitors; ++k) {
+                int d = distance(x, monitors[k].x, monitors[k].w) +
+                    distance(y, monitors[k].y, monitors[k].h);
+
+                if (best < 0 || d < best_distance) {
+                    best = k;
+                    best_distance = d;
+                }
+            }
+            cells[i][j] = best;
+        }
+    }
+}
+
+// Replace the monitors. Monitors without area are ignored.
+void
+monitor_set(const struct monitor *m, int n)
+{
+    nmonitors = 0;
+    for (int i = 0; i < n && nmonitors < MAX_MONITORS; ++i) {
+        if (m[i].w > 0 && m[i].h > 0)
+            monitors[nmonitors++] = m[i];
+    }
+    rebuild();
+}
+
+// Copy the monitors, and return the number of them.
+int
+monitor_get(struct monitor *m)
+{
+    memcpy(m, monitors, nmonitors * sizeof(*m));
+    return nmonitors;
+}
+
+// Update the area of the CRTC, which is disabled if w or h is 0.
+void
+monitor_update(xcb_randr_crtc_t crtc, int16_t x, int16_t y, uint16_t w,
+    uint16_t h)
+{
+    int i;
+
+    for (i = 0; i < nmonitors && monitors[i].crtc != crtc; ++i)
+        ;
+    if (w == 0 || h == 0) {
+        if (i == nmonitors)
+            return;
+        monitors[i] = monitors[--nmonitors];
+    } else if (i < MAX_MONITORS) {
+        monitors[i] = (struct monitor) { crtc, x, y, w, h };
+        if (i == nmonitors)
+            ++nmonitors;
+    }
+    rebuild();
+}
+
+// Update the size of the screen.
+void
+monitor_resize_screen(uint16_t width, uint16_t height)
+{
+    wm.screen->width_in_pixels = width;
+    wm.screen->height_in_pixels = height;
+    rebuild();
+}
+
+// Find the monitor at the point, or a nearby one if the point is not on any
+// monitor. It never fails, since the whole screen is used as a monitor
+// if no monitor is known.
+const struct monitor *
+monitor_at(int x, int y)
+{
+    if (nmonitors == 0) {
+        screen.w = wm.screen->width_in_pixels;
+        screen.h = wm.screen->height_in_pixels;
+        return &screen;
+    }
+    x = MAX(0, MIN(x, ncolumns - 1));
+    y = MAX(0, MIN(y, nrows - 1));
+    return &monitors[cells[columns[x]][rows[y]]];
+}
+
+bool
+monitor_contains(const struct monitor *m, int x, int y)
+{
+    return x >= m->x && x < m->x + m->w && y >= m->y && y < m->y + m->h;
+}
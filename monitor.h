@@ -0,0 +1,24 @@
+#ifndef WM0_MONITOR_H
+#define WM0_MONITOR_H
+
+#include <stdbool.h>
+#include <xcb/randr.h>
+
+#define MAX_MONITORS 16
+
+// A monitor is the area of the screen shown by an active CRTC.
+struct monitor {
+    xcb_randr_crtc_t crtc;  // CRTC showing the area, or 0 without RandR
+    int16_t x, y;           // Coordinate of the area
+    uint16_t w, h;          // Width and height of the area
+};
+
+void monitor_set(const struct monitor *monitors, int n);
+int monitor_get(struct monitor *monitors);
+void monitor_update(xcb_randr_crtc_t crtc, int16_t x, int16_t y, uint16_t w,
+    uint16_t h);
+void monitor_resize_screen(uint16_t width, uint16_t height);
+const struct monitor *monitor_at(int x, int y);
+bool monitor_contains(const struct monitor *m, int x, int y);
+
+#endif // WM0_MONITOR_H
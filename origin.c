@@ -0,0 +1,54 @@
+// Origins of the requests, for attributing asynchronous errors.
+//
+// Errors of requests without replies arrive as events, long after the
+// handler which sent the request has returned. XCB_SEND in wm0.h notes each
+// request in a ring indexed by the low bits of its sequence number, with the
+// window, the request and the handler, so the error is traced back in O(1)
+// by its full sequence number. A slot is overwritten by a request sent
+// RING_SIZE requests later, which is far beyond the requests in flight.
+
+#include "wm0.h"
+#include "origin.h"
+
+#define RING_SIZE 4096  // Number of requests remembered (power of 2)
+
+static struct origin ring[RING_SIZE];
+static uint8_t handler;  // Type of the event being handled, or 0
+
+// Start handling the event.
+void
+origin_begin(const xcb_generic_event_t *event)
+{
+    handler = event->response_type & ~0x80;
+}
+
+// Finish handling the event. Requests sent afterwards (e.g. for painting)
+// belong to no handler.
+void
+origin_end(void)
+{
+    handler = 0;
+}
+
+// Note the request, and return its sequence number.
+unsigned int
+origin_note(unsigned int sequence, xcb_window_t window, const char *request)
+{
+    struct origin *o = &ring[sequence & (RING_SIZE - 1)];
+
+    o->sequence = sequence;
+    o->window = window;
+    o->request = request;
+    o->handler = handler;
+    return sequence;
+}
+
+// Find the request with the full sequence number.
+// Return NULL if it was not sent by XCB_SEND, or is too old.
+const struct origin *
+origin_find(unsigned int sequence)
+{
+    const struct origin *o = &ring[sequence & (RING_SIZE - 1)];
+
+    return o->request != NULL && o->sequence == sequence ? o : NULL;
+}
@@ -0,0 +1,21 @@
+#ifndef WM0_ORIGIN_H
+#define WM0_ORIGIN_H
+
+#include <stdint.h>
+#include <xcb/xcb.h>
+
+// Origin of a request sent by XCB_SEND
+struct origin {
+    unsigned int sequence;  // Sequence number of the request
+    xcb_window_t window;    // Client window the request is about
+    const char *request;    // Name of the request
+    uint8_t handler;        // Type of the event being handled, or 0
+};
+
+void origin_begin(const xcb_generic_event_t *event);
+void origin_end(void);
+unsigned int origin_note(unsigned int sequence, xcb_window_t window,
+    const char *request);
+const struct origin *origin_find(unsigned int sequence);
+
+#endif // WM0_ORIGIN_H
@@ -0,0 +1,138 @@
+// Overview of the windows (like Exposé), toggled by Modkey + Tab while
+// compositing.
+//
+// All managed windows, including the ones on the other desktops and the
+// iconified ones, are laid out in a grid on the monitor of the focused
+// window, and painted as thumbnails by the compositor. The thumbnails are
+// cached by the compositor (see compositor.c), so opening the overview again
+// renders only the windows changed since.
+//
+// Clicks in the overview are caught by an input-only window covering the
+// screen. Clicking a thumbnail brings its window to the current desktop and
+// focuses it, and clicking elsewhere just closes the overview.
+
+#include "wm0.h"
+#include "window.h"
+#include "monitor.h"
+#include "compositor.h"
+#include "overview.h"
+
+#define GAP 16  // Space around each thumbnail (pixels)
+
+static xcb_window_t input;  // Window catching the clicks, or 0 if closed
+
+static void layout(void);
+static void open_overview(void);
+
+// Lay out the windows from the bottom to the top of the stack, row by row,
+// each scaled down to fit its cell. A window is never scaled up.
+static void
+layout(void)
+{
+    struct window *win, *current = window_get_current();
+    const struct monitor *m;
+    int n = 0, columns, rows, i = 0;
+
+    for (win = window_bottom(); win != NULL; win = TAILQ_NEXT(win, stack_link))
+        ++n;
+    if (n == 0)
+        return;
+    for (columns = 1; columns * columns < n; ++columns)
+        ;
+    rows = (n + columns - 1) / columns;
+    if (current != NULL) {
+        m = monitor_at(current->x + current->w / 2,
+            current->y + current->h / 2);
+    } else {
+        m = monitor_at(0, 0);
+    }
+
+    for (win = window_bottom(); win != NULL;
+        win = TAILQ_NEXT(win, stack_link), ++i) {
+        int cell_w = m->w / columns, cell_h = m->h / rows;
+        int w = win->w + 2 * win->bw, h = win->h + 2 * win->bw;
+        int max_w = MAX(cell_w - 2 * GAP, 1), max_h = MAX(cell_h - 2 * GAP, 1);
+
+        // Scale by the smaller ratio, in integers.
+        if ((long)w * max_h > (long)h * max_w) {
+            if (w > max_w) {
+                h = MAX((long)h * max_w / w, 1);
+                w = max_w;
+            }
+        } else if (h > max_h) {
+            w = MAX((long)w * max_h / h, 1);
+            h = max_h;
+        }
+        compositor_thumbnail(win,
+            m->x + i % columns * cell_w + (cell_w - w) / 2,
+            m->y + i / columns * cell_h + (cell_h - h) / 2, w, h);
+    }
+}
+
+static void
+open_overview(void)
+{
+    layout();
+    compositor_overview(true);
+
+    input = xcb_generate_id(wm.conn);
+    xcb_create_window(wm.conn, 0, input, wm.screen->root, 0, 0,
+        wm.screen->width_in_pixels, wm.screen->height_in_pixels, 0,
+        XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT,
+        XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK,
+        (const uint32_t []) { true, XCB_EVENT_MASK_BUTTON_PRESS });
+    xcb_map_window(wm.conn, input);
+}
+
+// Close the overview, if it is open.
+void
+overview_close(void)
+{
+    if (input == XCB_NONE)
+        return;
+    xcb_destroy_window(wm.conn, input);
+    input = XCB_NONE;
+    compositor_overview(false);
+}
+
+// Open or close the overview. Nothing is done without compositing.
+void
+overview_toggle(void)
+{
+    if (!wm.compositing)
+        return;
+    if (input == XCB_NONE)
+        open_overview();
+    else
+        overview_close();
+}
+
+// Handle a click in the overview, and return true, or return false if the
+// click is not in the overview.
+bool
+overview_click(xcb_button_press_event_t *ev)
+{
+    struct window *win;
+
+    if (input == XCB_NONE || ev->event != input)
+        return false;
+
+    // Thumbnails do not overlap, so the first one found is the one clicked.
+    for (win = window_bottom(); win != NULL;
+        win = TAILQ_NEXT(win, stack_link)) {
+        if (win->comp.thumb.shown &&
+            ev->root_x >= win->comp.thumb.x &&
+            ev->root_x < win->comp.thumb.x + win->comp.thumb.w &&
+            ev->root_y >= win->comp.thumb.y &&
+            ev->root_y < win->comp.thumb.y + win->comp.thumb.h)
+            break;
+    }
+    overview_close();
+    if (win != NULL) {
+        window_restore(win);
+        window_send_to_desktop(win, wm.desktop);
+        window_raise(win);
+        window_focus(win);
+    }
+    return true;
+}
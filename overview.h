@@ -0,0 +1,11 @@
+#ifndef WM0_OVERVIEW_H
+#define WM0_OVERVIEW_H
+
+#include <stdbool.h>
+#include <xcb/xcb.h>
+
+void overview_toggle(void);
+void overview_close(void);
+bool overview_click(xcb_button_press_event_t *ev);
+
+#endif // WM0_OVERVIEW_H
@@ -0,0 +1,159 @@
+// Positions of windows remembered across restarts (enabled by `wm0 -p file`).
+//
+// The last position of the windows of each WM_CLASS and WM_WINDOW_ROLE is
+// kept in a hash table of fixed size, which is the file itself mapped into
+// memory. Looking up and storing a position are thus plain memory accesses
+// without system calls, and the kernel writes the changed pages back to the
+// file lazily, or when wm0 exits. Positions are stored when a window is
+// unmanaged and when a drag ends, not on each motion.
+//
+// Keys are 64-bit hashes of the class, the instance and the role, so a slot
+// has a fixed size. When all the slots a key may take are used, the first
+// one is overwritten. The file is in the byte order of the host.
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "wm0.h"
+#include "window.h"
+#include "tile.h"
+#include "places.h"
+
+#define MAGIC      "wm0place"
+#define TABLE_SIZE 4096  // Number of slots (power of 2)
+#define MAX_PROBE  8     // Number of slots a key may take
+
+struct slot {
+    uint64_t key;  // Key of the windows, or 0 if the slot is free
+    int16_t x, y;  // Position of the windows
+};
+
+struct file {
+    char magic[8];
+    uint64_t size;  // TABLE_SIZE
+    struct slot slots[TABLE_SIZE];
+};
+
+static struct file *file;  // Mapped file, or NULL if not enabled
+
+static struct slot *find(uint64_t key, bool add);
+
+// Find the slot of the key. If it is not found and add is true, return a
+// slot to take, otherwise NULL.
+static struct slot *
+find(uint64_t key, bool add)
+{
+    struct slot *s;
+
+    for (size_t i = 0; i < MAX_PROBE; ++i) {
+        s = &file->slots[(key + i) & (TABLE_SIZE - 1)];
+        if (s->key == key)
+            return s;
+        if (s->key == 0)
+            return add ? s : NULL;
+    }
+    return add ? &file->slots[key & (TABLE_SIZE - 1)] : NULL;
+}
+
+// Map the file, creating it if it does not exist. A file written in another
+// format is cleared.
+bool
+places_open(const char *path)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    void *p;
+
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, sizeof(struct file)) < 0) {
+        close(fd);
+        return false;
+    }
+    p = mmap(NULL, sizeof(struct file), PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    file = p;
+    if (memcmp(file->magic, MAGIC, sizeof(file->magic)) != 0 ||
+        file->size != TABLE_SIZE) {
+        memset(file, 0, sizeof(struct file));
+        memcpy(file->magic, MAGIC, sizeof(file->magic));
+        file->size = TABLE_SIZE;
+    }
+    return true;
+}
+
+// Unmap the file, which is written back by the kernel.
+void
+places_close(void)
+{
+    if (file == NULL)
+        return;
+    munmap(file, sizeof(struct file));
+    file = NULL;
+}
+
+// Return whether positions are remembered.
+bool
+places_enabled(void)
+{
+    return file != NULL;
+}
+
+// Return the key of the windows with WM_CLASS and WM_WINDOW_ROLE (which is
+// not terminated by NUL), or 0 if they are not remembered.
+uint64_t
+places_key(const char *instance, const char *class, const char *role,
+    size_t role_len)
+{
+    // FNV-1a, with NULs between the strings
+    uint64_t h = 14695981039346656037u;
+
+    if (file == NULL || *class == '\0')
+        return 0;
+    for (const char *s = class; ; ++s) {
+        h = (h ^ (unsigned char)*s) * 1099511628211u;
+        if (*s == '\0')
+            break;
+    }
+    for (const char *s = instance; ; ++s) {
+        h = (h ^ (unsigned char)*s) * 1099511628211u;
+        if (*s == '\0')
+            break;
+    }
+    for (size_t i = 0; i < role_len; ++i)
+        h = (h ^ (unsigned char)role[i]) * 1099511628211u;
+    return h != 0 ? h : 1;
+}
+
+// Move the window to the remembered position, if any.
+// The position is only updated in win, and sent by the caller.
+bool
+places_recall(struct window *win)
+{
+    const struct slot *s;
+
+    if (file == NULL || win->place_key == 0 ||
+        (s = find(win->place_key, false)) == NULL)
+        return false;
+    win->x = s->x;
+    win->y = s->y;
+    return true;
+}
+
+// Remember the position of the window. Windows laid out by tile.c are not
+// remembered, since their positions are given by the layout.
+void
+places_store(const struct window *win)
+{
+    struct slot *s;
+
+    if (file == NULL || win->place_key == 0 || tile_fixed(win))
+        return;
+    s = find(win->place_key, true);
+    s->key = win->place_key;
+    s->x = win->x;
+    s->y = win->y;
+}
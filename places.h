@@ -0,0 +1,17 @@
+#ifndef WM0_PLACES_H
+#define WM0_PLACES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "window.h"
+
+bool places_open(const char *path);
+void places_close(void);
+bool places_enabled(void);
+uint64_t places_key(const char *instance, const char *class, const char *role,
+    size_t role_len);
+bool places_recall(struct window *win);
+void places_store(const struct window *win);
+
+#endif // WM0_PLACES_H
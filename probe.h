@@ -0,0 +1,56 @@
+#ifndef WM0_PROBE_H
+#define WM0_PROBE_H
+
+// USDT probes of the provider wm0, for perf(1), bpftrace(8) and SystemTap.
+//
+// With <sys/sdt.h> (systemtap-sdt-dev), each probe is compiled to a single
+// nop and a note in the ELF file, which tracers turn into a breakpoint when
+// they attach. The arguments must be cheap to compute, since they are
+// computed whether or not a tracer is attached. Without <sys/sdt.h>, or with
+// -DNO_PROBES, probes are compiled to nothing.
+//
+// The probes are listed by `perf list sdt` after `perf buildid-cache --add
+// wm0`, or by `bpftrace -l 'usdt:./wm0:*'`.
+
+#if !defined(NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_PROBES
+#endif
+#endif
+
+#ifdef HAVE_PROBES
+
+#define PROBE(name) DTRACE_PROBE(wm0, name)
+#define PROBE1(name, a) DTRACE_PROBE1(wm0, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(wm0, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(wm0, name, a, b, c)
+#define PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(wm0, name, a, b, c, d, e)
+
+// Probes within expressions (see the blocking macros in wm0.h)
+static inline void
+probe_wait(const char *request)
+{
+    PROBE1(reply_wait, request);
+}
+
+static inline void *
+probe_reply(const char *request, void *reply)
+{
+    PROBE2(reply_done, request, reply);
+    return reply;
+}
+
+#else
+
+#define PROBE(name) ((void)0)
+#define PROBE1(name, a) ((void)0)
+#define PROBE2(name, a, b) ((void)0)
+#define PROBE3(name, a, b, c) ((void)0)
+#define PROBE5(name, a, b, c, d, e) ((void)0)
+#define probe_wait(request) ((void)0)
+#define probe_reply(request, reply) (reply)
+
+#endif // HAVE_PROBES
+
+#endif // WM0_PROBE_H
@@ -0,0 +1,222 @@
+// wm0-replay - Feed a trace recorded by `wm0 -t` to the handlers, and report
+// the time spent for each type of events.
+//
+// This is linked with fakexcb.c instead of libxcb, so the X server is not
+// needed. Replies are taken from the trace in the order they were recorded.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "wm0.h"
+#include "window.h"
+#include "compositor.h"
+#include "places.h"
+#include "fakexcb.h"
+
+struct wm wm;
+
+static FILE *fp;                   // Trace file
+static struct trace_record next;   // Next record of the trace
+static void *next_data;            // Data of the next record
+static bool has_next;              // Whether the next record exists
+static unsigned long mismatches;   // Number of replies missing in the trace
+
+// Names of the events handled by the WM (0 is for errors)
+static const char *names[] = {
+    [0] = "Error",
+    [XCB_BUTTON_PRESS] = "ButtonPress",
+    [XCB_BUTTON_RELEASE] = "ButtonRelease",
+    [XCB_MOTION_NOTIFY] = "MotionNotify",
+    [XCB_UNMAP_NOTIFY] = "UnmapNotify",
+    [XCB_DESTROY_NOTIFY] = "DestroyNotify",
+    [XCB_MAP_REQUEST] = "MapRequest",
+    [XCB_CONFIGURE_REQUEST] = "ConfigureRequest",
+    [XCB_PROPERTY_NOTIFY] = "PropertyNotify",
+};
+
+// Statistics for each type of events
+static struct {
+    unsigned long count;
+    uint64_t time;
+} stats[128];
+
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Read the next record into the lookahead.
+static void
+advance(void)
+{
+    has_next = trace_read(fp, &next, &next_data);
+}
+
+// Supply the recorded reply to the fake libxcb.
+static void *
+replay_reply(unsigned int sequence)
+{
+    void *reply;
+
+    if (!has_next || next.kind != TRACE_REPLY) {
+        // The handlers requested a reply which was not requested when
+        // recording. This happens when the handlers have been changed.
+        ++mismatches;
+        return NULL;
+    }
+    reply = next_data;
+    advance();
+    return reply;
+}
+
+// Tell whether the polled reply had arrived when recording, which is when
+// it was recorded next.
+static bool
+replay_poll(unsigned int sequence)
+{
+    return has_next && next.kind == TRACE_REPLY;
+}
+
+// Replay the whole trace once.
+static void
+replay(void)
+{
+    rewind(fp);
+    trace_read_header(fp, &(struct trace_header){ 0 });
+    advance();
+
+    window_init();
+    window_scan();
+
+    while (has_next) {
+        xcb_generic_event_t *event = next_data;
+        uint64_t t;
+        int type;
+
+        if (next.kind != TRACE_EVENT) {
+            // Extra replies, which were requested when recording
+            ++mismatches;
+            free(next_data);
+            advance();
+            continue;
+        }
+        advance();
+
+        type = event->response_type & ~0x80;
+        t = now();
+        handle_event(event);
+        stats[type].time += now() - t;
+        ++stats[type].count;
+        free(event);
+        // Take the replies taken by run() after the batch of events.
+        window_poll_hints();
+    }
+
+    window_unmanage_all();
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct trace_header header;
+    xcb_screen_t screen = { 0 };
+    unsigned long count = 0;
+    uint64_t total = 0;
+    int c, repeat = 1;
+
+    while ((c = getopt(argc, argv, "n:")) != -1) {
+        switch (c) {
+        case 'n':
+            repeat = atoi(optarg);
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind + 1 != argc)
+        goto usage;
+
+    fp = fopen(argv[optind], "rb");
+    if (fp == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (!trace_read_header(fp, &header)) {
+        fprintf(stderr, "%s: not a trace of this version\n", argv[optind]);
+        return 1;
+    }
+
+    screen.root = header.root;
+    screen.width_in_pixels = header.width;
+    screen.height_in_pixels = header.height;
+    wm.screen = &screen;
+    wm.conf = header.conf;
+    wm.atoms = header.atoms;
+    wm.sync_event = header.sync_event;
+    memcpy(wm.keycodes, header.keycodes, sizeof(wm.keycodes));
+    wm.randr_event = header.randr_event;
+    monitor_set(header.monitors, header.nmonitors);
+    wm.frames = header.frames;
+    wm.compositing = header.compositing;
+    wm.damage_event = header.damage_event;
+    wm.overview_key = header.overview_key;
+    wm.layout_key = header.layout_key;
+    // Windows are asked for WM_WINDOW_ROLE if positions were remembered.
+    // The positions themselves are remembered in a temporary file, which
+    // starts empty.
+    if (header.places) {
+        char path[] = "/tmp/wm0-replay.XXXXXX";
+        int fd = mkstemp(path);
+
+        if (fd < 0 || !places_open(path)) {
+            perror(path);
+            return 1;
+        }
+        close(fd);
+        unlink(path);
+    }
+    // Nothing is drawn when replaying, so any picture format works.
+    if (wm.compositing)
+        compositor_start(XCB_NONE);
+    wm.grab.mode = NO_GRAB;
+    fake_reply_hook = replay_reply;
+    fake_poll_hook = replay_poll;
+
+    for (int i = 0; i < repeat; ++i)
+        replay();
+
+    printf("%-20s %10s %12s %10s\n", "event", "count", "total(us)", "avg(ns)");
+    for (int i = 0; i < LENGTH(stats); ++i) {
+        char buf[16];
+
+        if (stats[i].count == 0)
+            continue;
+        if (i >= LENGTH(names) || names[i] == NULL)
+            snprintf(buf, sizeof(buf), "Event%d", i);
+        printf("%-20s %10lu %12.1f %10lu\n",
+            (i < LENGTH(names) && names[i] != NULL) ? names[i] : buf,
+            stats[i].count, stats[i].time / 1e3,
+            (unsigned long)(stats[i].time / stats[i].count));
+        count += stats[i].count;
+        total += stats[i].time;
+    }
+    if (count > 0) {
+        printf("%-20s %10lu %12.1f %10lu\n", "total", count, total / 1e3,
+            (unsigned long)(total / count));
+    }
+    if (mismatches > 0)
+        fprintf(stderr, "%lu replies did not match the trace\n", mismatches);
+
+    fclose(fp);
+    return mismatches > 0;
+
+usage:
+    fputs("usage: wm0-replay [-n count] trace_file\n", stderr);
+    return 1;
+}
@@ -0,0 +1,292 @@
+// Window rules.
+//
+// A rule gives policies to the windows of an application, which is matched
+// by WM_CLASS. Rules are written in the configuration file as:
+//
+//     rule <pattern> <policy>...
+//
+// where <pattern> is "class", "class:instance", or a prefix of
+// "class:instance" followed by '*'. Policies are desktop=N, position=X,Y,
+// border=N and focus=yes|no.
+//
+// Rules are compiled when the configuration file is loaded: exact patterns
+// go to a hash table, and prefixes go to a trie. Matching a window thus
+// costs two hash lookups and a walk of the trie along its class, however
+// many rules there are. When several rules match, the policies of the more
+// specific ones take precedence: a longer prefix, then the class, then the
+// class and the instance.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wm0.h"
+#include "rules.h"
+
+#define MAX_KEY 256  // Maximum length of "class:instance"
+
+// Rule as written in the configuration file
+struct entry {
+    char *pattern;     // Pattern without the trailing '*'
+    bool prefix;       // Whether the pattern is a prefix
+    struct rule rule;
+};
+
+// Node of the trie of the prefixes.
+// Children of a node are linked by `sibling`.
+struct node {
+    char c;        // Character of the edge from the parent
+    int child;     // First child, or -1
+    int sibling;   // Next sibling, or -1
+    int entry;     // Rule for the prefix ending here, or -1
+};
+
+static struct entry *entries;  // Rules in the order of the file
+static size_t nentries, entries_size;
+
+static int *table;             // Hash table of the exact patterns (index of
+static size_t table_size;      //   entries, or -1), with linear probing
+
+static struct node *trie;      // Trie of the prefixes (trie[0] is the root)
+static size_t ntrie, trie_size;
+
+static bool parse_policy(const char *policy, struct rule *rule);
+static uint32_t hash(const char *s);
+static int find(const char *key);
+static int add_node(char c);
+static void merge(struct rule *dst, const struct rule *src);
+
+// Remove all the rules.
+void
+rules_clear(void)
+{
+    for (size_t i = 0; i < nentries; ++i)
+        free(entries[i].pattern);
+    nentries = 0;
+    free(table);
+    table = NULL;
+    table_size = 0;
+    ntrie = 0;
+}
+
+// Parse a policy (key=value) into the rule.
+static bool
+parse_policy(const char *policy, struct rule *rule)
+{
+    char yes_no[4];
+    int a, b;
+    char end;
+
+    if (sscanf(policy, "desktop=%d%c", &a, &end) == 1 && a >= 1 &&
+        a <= DESKTOPS) {
+        rule->set |= RULE_DESKTOP;
+        rule->desktop = a - 1;
+    } else if (sscanf(policy, "position=%d,%d%c", &a, &b, &end) == 2 &&
+        a >= INT16_MIN && a <= INT16_MAX && b >= INT16_MIN && b <= INT16_MAX) {
+        rule->set |= RULE_POSITION;
+        rule->x = a;
+        rule->y = b;
+    } else if (sscanf(policy, "border=%d%c", &a, &end) == 1 && a >= 0 &&
+        a <= 100) {
+        rule->set |= RULE_BORDER;
+        rule->border = a;
+    } else if (sscanf(policy, "focus=%3s%c", yes_no, &end) == 1 &&
+        (strcmp(yes_no, "yes") == 0 || strcmp(yes_no, "no") == 0)) {
+        rule->set |= RULE_FOCUS;
+        rule->focus = yes_no[0] == 'y';
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parse a rule (the rest of the line after "rule"), and add it.
+// Return false if it is invalid.
+bool
+rules_parse(char *line)
+{
+    struct entry e = { 0 };
+    char *pattern, *policy;
+    size_t len;
+
+    if ((pattern = strtok(line, " \t\r\n")) == NULL)
+        return false;
+    len = strlen(pattern);
+    if (len >= MAX_KEY)
+        return false;
+    e.prefix = pattern[len - 1] == '*';
+    if (e.prefix)
+        pattern[--len] = '\0';
+    if (len == 0 && !e.prefix)
+        return false;
+
+    while ((policy = strtok(NULL, " \t\r\n")) != NULL) {
+        if (!parse_policy(policy, &e.rule))
+            return false;
+    }
+
+    if (nentries == entries_size) {
+        size_t size = entries_size ? entries_size * 2 : 16;
+        struct entry *p = realloc(entries, size * sizeof(*p));
+
+        if (p == NULL)
+            return false;
+        entries = p;
+        entries_size = size;
+    }
+    if ((e.pattern = strdup(pattern)) == NULL)
+        return false;
+    entries[nentries++] = e;
+    return true;
+}
+
+// FNV-1a
+static uint32_t
+hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+
+    while (*s != '\0')
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+// Find the slot of the key in the hash table.
+// Return the empty slot to insert the key, if not found.
+static int
+find(const char *key)
+{
+    size_t i = hash(key) & (table_size - 1);
+
+    while (table[i] >= 0 && strcmp(entries[table[i]].pattern, key) != 0)
+        i = (i + 1) & (table_size - 1);
+    return i;
+}
+
+// Append a node to the trie, and return its index, or -1.
+static int
+add_node(char c)
+{
+    if (ntrie == trie_size) {
+        size_t size = trie_size ? trie_size * 2 : 64;
+        struct node *p = realloc(trie, size * sizeof(*p));
+
+        if (p == NULL)
+            return -1;
+        trie = p;
+        trie_size = size;
+    }
+    trie[ntrie] = (struct node) { c, -1, -1, -1 };
+    return ntrie++;
+}
+
+// Copy the policies set in src to dst.
+static void
+merge(struct rule *dst, const struct rule *src)
+{
+    if (src->set & RULE_DESKTOP)
+        dst->desktop = src->desktop;
+    if (src->set & RULE_POSITION) {
+        dst->x = src->x;
+        dst->y = src->y;
+    }
+    if (src->set & RULE_BORDER)
+        dst->border = src->border;
+    if (src->set & RULE_FOCUS)
+        dst->focus = src->focus;
+    dst->set |= src->set;
+}
+
+// Build the hash table and the trie from the rules.
+// Rules with the same pattern are merged, and the later ones take
+// precedence.
+void
+rules_compile(void)
+{
+    size_t size = 16;
+
+    free(table);
+    table = NULL;
+    table_size = 0;
+    ntrie = 0;
+
+    while (size < nentries * 2)
+        size *= 2;
+    if ((table = malloc(size * sizeof(*table))) == NULL)
+        return;
+    table_size = size;
+    memset(table, -1, size * sizeof(*table));
+    if (add_node('\0') < 0)
+        return;
+
+    for (size_t i = 0; i < nentries; ++i) {
+        int *slot, n = 0;
+
+        if (!entries[i].prefix) {
+            slot = &table[find(entries[i].pattern)];
+            if (*slot < 0)
+                *slot = i;
+            else
+                merge(&entries[*slot].rule, &entries[i].rule);
+            continue;
+        }
+
+        for (const char *p = entries[i].pattern; *p != '\0'; ++p) {
+            int c = trie[n].child;
+
+            while (c >= 0 && trie[c].c != *p)
+                c = trie[c].sibling;
+            if (c < 0) {
+                if ((c = add_node(*p)) < 0)
+                    return;
+                trie[c].sibling = trie[n].child;
+                trie[n].child = c;
+            }
+            n = c;
+        }
+        if (trie[n].entry < 0)
+            trie[n].entry = i;
+        else
+            merge(&entries[trie[n].entry].rule, &entries[i].rule);
+    }
+}
+
+// Get the policies for the window of the class and the instance.
+struct rule
+rules_match(const char *instance, const char *class)
+{
+    struct rule rule = { 0 };
+    char key[MAX_KEY];
+    size_t class_len = strlen(class), instance_len = strlen(instance);
+    int n = 0, e = -1;
+
+    if (table_size == 0)
+        return rule;
+    // "class:instance", truncated to MAX_KEY - 1 characters.
+    class_len = MIN(class_len, MAX_KEY - 2);
+    instance_len = MIN(instance_len, MAX_KEY - 2 - class_len);
+    memcpy(key, class, class_len);
+    key[class_len] = ':';
+    memcpy(key + class_len + 1, instance, instance_len);
+    key[class_len + 1 + instance_len] = '\0';
+
+    // The longest prefix
+    for (const char *p = key; ntrie > 0; ++p) {
+        if (trie[n].entry >= 0)
+            e = trie[n].entry;
+        if (*p == '\0')
+            break;
+        for (n = trie[n].child; n >= 0 && trie[n].c != *p; )
+            n = trie[n].sibling;
+        if (n < 0)
+            break;
+    }
+    if (e >= 0)
+        merge(&rule, &entries[e].rule);
+
+    // The class, and then the class and the instance
+    if ((e = table[find(class)]) >= 0)
+        merge(&rule, &entries[e].rule);
+    if ((e = table[find(key)]) >= 0)
+        merge(&rule, &entries[e].rule);
+    return rule;
+}
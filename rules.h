@@ -0,0 +1,30 @@
+#ifndef WM0_RULES_H
+#define WM0_RULES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Policies to set in struct rule
+enum {
+    RULE_DESKTOP = 1 << 0,
+    RULE_POSITION = 1 << 1,
+    RULE_BORDER = 1 << 2,
+    RULE_FOCUS = 1 << 3
+};
+
+// Policies for windows of an application.
+// Only the members in `set` are valid.
+struct rule {
+    unsigned int set;  // Policies set (RULE_*)
+    uint8_t desktop;   // Desktop to put the window on
+    int16_t x, y;      // Position of the window
+    uint16_t border;   // Border width
+    bool focus;        // Whether to focus the window when mapped
+};
+
+void rules_clear(void);
+bool rules_parse(char *line);
+void rules_compile(void);
+struct rule rules_match(const char *instance, const char *class);
+
+#endif // WM0_RULES_H
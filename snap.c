@@ -0,0 +1,257 @@
+// Edge snapping.
+//
+// While a window is dragged, its edges snap to the edges of the monitor it
+// is on and the other windows within wm.conf.snap_distance pixels. The edges also
+// resist leaving, since the pointer must move that far to get away.
+//
+// The edges of the managed windows are kept in four arrays (left, right, top
+// and bottom edges) sorted by the coordinate, so the edges near a position
+// are found by binary search even with thousands of windows. The arrays are
+// updated by window.c whenever a window is moved or resized.
+
+#include <stdlib.h>
+#include <string.h>
+#include "wm0.h"
+#include "window.h"
+#include "monitor.h"
+#include "snap.h"
+
+// Sides of windows
+enum { LEFT, RIGHT, TOP, BOTTOM };
+
+// Axes
+enum { X, Y };
+
+struct edge {
+    int pos;             // x of left/right edges, or y of top/bottom edges
+    int lo, hi;          // Range covered by the edge along the other axis
+    struct window *win;  // Window of the edge
+};
+
+// Edges of a side sorted by pos
+static struct {
+    struct edge *edges;
+    size_t len, size;
+} indexes[4];
+
+// Get the edge of the given side of the window, including the border.
+static struct edge
+edge_of(const struct window *win, int side)
+{
+    int left = win->x, right = win->x + win->w + 2 * win->bw;
+    int top = win->y, bottom = win->y + win->h + 2 * win->bw;
+
+    switch (side) {
+    case LEFT:
+        return (struct edge) { left, top, bottom };
+    case RIGHT:
+        return (struct edge) { right, top, bottom };
+    case TOP:
+        return (struct edge) { top, left, right };
+    default:
+        return (struct edge) { bottom, left, right };
+    }
+}
+
+// Find the first edge of the side at pos or after.
+static size_t
+lower_bound(int side, int pos)
+{
+    size_t lo = 0, hi = indexes[side].len;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (indexes[side].edges[mid].pos < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Find the index of the edge of the side of win at pos.
+// Return the number of the edges if not found.
+static size_t
+find(int side, int pos, const struct window *win)
+{
+    size_t i;
+
+    for (i = lower_bound(side, pos); i < indexes[side].len &&
+        indexes[side].edges[i].pos == pos; ++i) {
+        if (indexes[side].edges[i].win == win)
+            return i;
+    }
+    return indexes[side].len;
+}
+
+// Add the edge of the side of the window.
+// If memory is exhausted, the edge is not added, and just does not snap.
+static void
+insert(struct window *win, int side)
+{
+    struct edge e = edge_of(win, side), *edges = indexes[side].edges;
+    size_t i;
+
+    if (indexes[side].len == indexes[side].size) {
+        size_t size = indexes[side].size ? indexes[side].size * 2 : 64;
+
+        edges = realloc(edges, size * sizeof(*edges));
+        if (edges == NULL)
+            return;
+        indexes[side].edges = edges;
+        indexes[side].size = size;
+    }
+    e.win = win;
+    i = lower_bound(side, e.pos);
+    memmove(&edges[i + 1], &edges[i],
+        (indexes[side].len++ - i) * sizeof(*edges));
+    edges[i] = e;
+}
+
+// Remove the edge of the side of the window.
+static void
+erase(struct window *win, int side)
+{
+    struct edge *edges = indexes[side].edges;
+    size_t i = find(side, edge_of(win, side).pos, win);
+
+    if (i < indexes[side].len) {
+        memmove(&edges[i], &edges[i + 1],
+            (--indexes[side].len - i) * sizeof(*edges));
+    }
+}
+
+// Move the edge of the side of the window from the position in the old
+// geometry to the current one.
+// Only the edges between the two positions are shifted, which are few while
+// the window is dragged.
+static void
+relocate(struct window *win, const struct window *old, int side)
+{
+    struct edge e = edge_of(win, side), *edges = indexes[side].edges;
+    size_t i = find(side, edge_of(old, side).pos, win), j;
+
+    if (i == indexes[side].len) {
+        insert(win, side);
+        return;
+    }
+    e.win = win;
+    j = lower_bound(side, e.pos);
+    if (j > i) {
+        // Moved forward: j is past the edge itself.
+        memmove(&edges[i], &edges[i + 1], (j - 1 - i) * sizeof(*edges));
+        edges[j - 1] = e;
+    } else {
+        memmove(&edges[j + 1], &edges[j], (i - j) * sizeof(*edges));
+        edges[j] = e;
+    }
+}
+
+// Add the edges of the window to the indexes.
+void
+snap_add(struct window *win)
+{
+    for (int side = LEFT; side <= BOTTOM; ++side)
+        insert(win, side);
+}
+
+// Remove the edges of the window from the indexes.
+// The geometry of the window must not be changed since the last update.
+void
+snap_remove(struct window *win)
+{
+    for (int side = LEFT; side <= BOTTOM; ++side)
+        erase(win, side);
+}
+
+// Update the edges of the window, which had the geometry of old.
+void
+snap_update(struct window *win, const struct window *old)
+{
+    for (int side = LEFT; side <= BOTTOM; ++side)
+        relocate(win, old, side);
+}
+
+// Find the nearest edge to pos, among the edges of the side covering
+// [lo, hi] (other than those of win and its transients, which move with
+// it, and those of the windows not shown), which is nearer than *best.
+// If found, set *best to the distance, and *offset to the offset to it.
+static void
+nearest(int side, int pos, int lo, int hi, const struct window *win,
+    int *best, int *offset)
+{
+    const struct edge *edges = indexes[side].edges;
+
+    for (size_t i = lower_bound(side, pos - *best + 1);
+        i < indexes[side].len && edges[i].pos < pos + *best; ++i) {
+        if (edges[i].win == win || edges[i].win->leader == win ||
+            edges[i].win->desktop != wm.desktop || edges[i].win->iconic ||
+            edges[i].hi < lo || edges[i].lo > hi)
+            continue;
+        *best = abs(edges[i].pos - pos);
+        *offset = edges[i].pos - pos;
+    }
+}
+
+// Get the offset to snap any of the n edges of the window at pos[] along the
+// axis, covering [lo, hi] along the other axis, to the edges of the monitor
+// m or other windows. Return 0 if nothing is near.
+static int
+snap(const struct window *win, const struct monitor *m, int axis,
+    const int *pos, int n, int lo, int hi)
+{
+    int start = (axis == X) ? m->x : m->y;
+    int end = start + ((axis == X) ? m->w : m->h);
+    int best = wm.conf.snap_distance + 1, offset = 0;
+
+    for (int i = 0; i < n; ++i) {
+        // Edges of the monitor
+        if (abs(start - pos[i]) < best) {
+            best = abs(start - pos[i]);
+            offset = start - pos[i];
+        }
+        if (abs(end - pos[i]) < best) {
+            best = abs(end - pos[i]);
+            offset = end - pos[i];
+        }
+
+        // Edges of the other windows, to put the windows side by side or to
+        // align them.
+        nearest(axis == X ? LEFT : TOP, pos[i], lo, hi, win, &best, &offset);
+        nearest(axis == X ? RIGHT : BOTTOM, pos[i], lo, hi, win, &best,
+            &offset);
+    }
+    return offset;
+}
+
+// Adjust the position to move the window to, so that it snaps to edges.
+void
+snap_move(struct window *win, int *x, int *y)
+{
+    int w = win->w + 2 * win->bw, h = win->h + 2 * win->bw;
+    const struct monitor *m;
+
+    if (wm.conf.snap_distance == 0)
+        return;
+    m = monitor_at(*x + w / 2, *y + h / 2);
+    *x += snap(win, m, X, (const int []) { *x, *x + w }, 2, *y, *y + h);
+    *y += snap(win, m, Y, (const int []) { *y, *y + h }, 2, *x, *x + w);
+}
+
+// Adjust the size to resize the window to, so that its right and bottom
+// edges snap to edges.
+void
+snap_resize(struct window *win, int *w, int *h)
+{
+    int right = win->x + *w + 2 * win->bw, bottom = win->y + *h + 2 * win->bw;
+    const struct monitor *m;
+
+    if (wm.conf.snap_distance == 0)
+        return;
+    m = monitor_at((win->x + right) / 2, (win->y + bottom) / 2);
+    *w += snap(win, m, X, &right, 1, win->y, bottom);
+    *h += snap(win, m, Y, &bottom, 1, win->x, right);
+    *w = MAX(*w, 1);
+    *h = MAX(*h, 1);
+}
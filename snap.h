@@ -0,0 +1,12 @@
+#ifndef WM0_SNAP_H
+#define WM0_SNAP_H
+
+#include "window.h"
+
+void snap_add(struct window *win);
+void snap_remove(struct window *win);
+void snap_update(struct window *win, const struct window *old);
+void snap_move(struct window *win, int *x, int *y);
+void snap_resize(struct window *win, int *w, int *h);
+
+#endif // WM0_SNAP_H
@@ -0,0 +1,242 @@
+// Tiling layouts.
+//
+// Each desktop has a layout, which starts with the one in the configuration
+// and is cycled by Modkey + Space. Windows are tiled on the monitor at the
+// origin of the screen, in the order they were managed. Transients are not
+// tiled, but follow their leader as usual, and iconified windows leave their
+// cell to the others.
+//
+// Layouts are recomputed incrementally: a change marks its desktop dirty from
+// the first position whose cell may change, and tile_arrange() lays out only
+// the windows from there. The cells of the others depend on the number of
+// windows only through the shape of the layout (e.g. the number of columns
+// of the grid), so a map or unmap that keeps the shape configures only the
+// windows after it. A window whose cell is unchanged sends nothing, so the
+// requests stay proportional to the windows which actually move.
+// Desktops other than the current one are arranged when switched to.
+
+#include <limits.h>
+#include "wm0.h"
+#include "window.h"
+#include "monitor.h"
+#include "tile.h"
+
+static TAILQ_HEAD(tiles, window) tiles[DESKTOPS];  // Tiled windows
+static uint8_t layouts[DESKTOPS];  // Layout of each desktop
+static int counts[DESKTOPS];       // Number of tiled windows not iconified
+static int arranged[DESKTOPS];     // Number of them when last arranged
+static int dirty[DESKTOPS];        // First position to arrange, or INT_MAX
+static struct monitor area;        // Area tiled when last arranged
+
+static int position(const struct window *win);
+static void mark(uint8_t desktop, int from);
+static int columns(int n);
+static int first_changed(uint8_t layout, int old, int n);
+static void cell(uint8_t layout, int i, int n, int *x, int *y, int *w,
+    int *h);
+
+void
+tile_init(void)
+{
+    for (int i = 0; i < DESKTOPS; ++i) {
+        TAILQ_INIT(&tiles[i]);
+        layouts[i] = wm.conf.layout;
+        counts[i] = arranged[i] = 0;
+        dirty[i] = INT_MAX;
+    }
+    area = (struct monitor) { 0 };
+}
+
+// Get the position of the window among the tiled windows not iconified on
+// its desktop.
+static int
+position(const struct window *win)
+{
+    const struct window *w;
+    int i = 0;
+
+    TAILQ_FOREACH(w, &tiles[win->desktop], tile_link) {
+        if (w == win)
+            break;
+        if (!w->iconic)
+            ++i;
+    }
+    return i;
+}
+
+// Arrange the desktop from the position at the next tile_arrange().
+static void
+mark(uint8_t desktop, int from)
+{
+    dirty[desktop] = MIN(dirty[desktop], from);
+}
+
+// Add the window to the end of its desktop, unless it is a transient.
+void
+tile_add(struct window *win)
+{
+    win->tiled = win->leader == NULL;
+    if (!win->tiled)
+        return;
+    TAILQ_INSERT_TAIL(&tiles[win->desktop], win, tile_link);
+    if (!win->iconic)
+        mark(win->desktop, counts[win->desktop]++);
+}
+
+// Remove the window from its desktop. The windows after it move up.
+void
+tile_remove(struct window *win)
+{
+    if (!win->tiled)
+        return;
+    if (!win->iconic) {
+        mark(win->desktop, position(win));
+        --counts[win->desktop];
+    }
+    TAILQ_REMOVE(&tiles[win->desktop], win, tile_link);
+    win->tiled = false;
+}
+
+// Take the change of win->iconic into account. The window keeps its place
+// in the order, so it gets the same cell back when restored.
+void
+tile_update(struct window *win)
+{
+    if (!win->tiled)
+        return;
+    mark(win->desktop, position(win));
+    counts[win->desktop] += win->iconic ? -1 : 1;
+}
+
+// Check whether the geometry of the window is decided by the layout, rather
+// than by the client.
+bool
+tile_fixed(const struct window *win)
+{
+    return win->tiled && layouts[win->desktop] != LAYOUT_FLOAT;
+}
+
+uint8_t
+tile_get_layout(uint8_t desktop)
+{
+    return layouts[desktop];
+}
+
+// Set the layout of the desktop, which is arranged again as a whole.
+// Switching to LAYOUT_FLOAT leaves the windows where they are.
+void
+tile_set_layout(uint8_t desktop, uint8_t layout)
+{
+    LOG(MSG_LAYOUT, desktop, layout);
+
+    layouts[desktop] = layout;
+    mark(desktop, 0);
+}
+
+// Get the number of columns of the grid for n windows.
+static int
+columns(int n)
+{
+    int c = 1;
+
+    while (c * c < n)
+        ++c;
+    return c;
+}
+
+// Get the first position whose cell changes when the number of windows
+// changes from old to n, or INT_MAX if no cell does.
+static int
+first_changed(uint8_t layout, int old, int n)
+{
+    switch (layout) {
+    case LAYOUT_MASTER:
+        // The master fills the area while alone, and the stack is split
+        // evenly.
+        return old <= 1 || n <= 1 ? 0 : 1;
+    case LAYOUT_GRID:
+        // All cells keep their size while the grid keeps its shape.
+        if (columns(old) == columns(n) &&
+            (old + columns(old) - 1) / columns(old) ==
+            (n + columns(n) - 1) / columns(n))
+            return INT_MAX;
+        return 0;
+    default:
+        return INT_MAX;
+    }
+}
+
+// Get the cell of the window at the position i out of n windows, in the
+// area including the border.
+static void
+cell(uint8_t layout, int i, int n, int *x, int *y, int *w, int *h)
+{
+    int master = area.w * wm.conf.master_size / 100, c, r;
+
+    switch (layout) {
+    case LAYOUT_MASTER:
+        if (n == 1) {
+            *x = area.x;
+            *y = area.y;
+            *w = area.w;
+            *h = area.h;
+        } else if (i == 0) {
+            *x = area.x;
+            *y = area.y;
+            *w = master;
+            *h = area.h;
+        } else {
+            // Rounding is spread over the stack, rather than left at the end.
+            *x = area.x + master;
+            *y = area.y + area.h * (i - 1) / (n - 1);
+            *w = area.w - master;
+            *h = area.y + area.h * i / (n - 1) - *y;
+        }
+        break;
+    default:  // LAYOUT_GRID
+        c = columns(n);
+        r = (n + c - 1) / c;
+        *x = area.x + area.w * (i % c) / c;
+        *y = area.y + area.h * (i / c) / r;
+        *w = area.x + area.w * (i % c + 1) / c - *x;
+        *h = area.y + area.h * (i / c + 1) / r - *y;
+        break;
+    }
+}
+
+// Lay out the dirty part of the desktop.
+void
+tile_arrange(uint8_t desktop)
+{
+    const struct monitor *m = monitor_at(0, 0);
+    struct window *win;
+    int n = counts[desktop], from, i = 0;
+
+    // Every cell depends on the area.
+    if (m->x != area.x || m->y != area.y || m->w != area.w || m->h != area.h) {
+        area = *m;
+        for (int d = 0; d < DESKTOPS; ++d)
+            mark(d, 0);
+    }
+
+    from = dirty[desktop];
+    if (n != arranged[desktop])
+        from = MIN(from, first_changed(layouts[desktop], arranged[desktop], n));
+    dirty[desktop] = INT_MAX;
+    arranged[desktop] = n;
+    if (layouts[desktop] == LAYOUT_FLOAT || from >= n)
+        return;
+
+    TAILQ_FOREACH(win, &tiles[desktop], tile_link) {
+        int x, y, w, h;
+
+        if (win->iconic)
+            continue;
+        if (i >= from) {
+            cell(layouts[desktop], i, n, &x, &y, &w, &h);
+            window_move_resize(win, x, y, MAX(w - 2 * win->bw, 1),
+                MAX(h - 2 * win->bw, 1));
+        }
+        ++i;
+    }
+}
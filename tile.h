@@ -0,0 +1,25 @@
+#ifndef WM0_TILE_H
+#define WM0_TILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "window.h"
+
+// Layouts of a desktop
+enum {
+    LAYOUT_FLOAT,   // Windows stay where they are put
+    LAYOUT_MASTER,  // The first window on the left, the others stacked right
+    LAYOUT_GRID,    // All windows in a grid of the same cells
+    LAYOUTS         // Number of the layouts
+};
+
+void tile_init(void);
+void tile_add(struct window *win);
+void tile_remove(struct window *win);
+void tile_update(struct window *win);
+bool tile_fixed(const struct window *win);
+uint8_t tile_get_layout(uint8_t desktop);
+void tile_set_layout(uint8_t desktop, uint8_t layout);
+void tile_arrange(uint8_t desktop);
+
+#endif // WM0_TILE_H
@@ -0,0 +1,143 @@
+// Recording of the events and replies received from the X server.
+//
+// The trace can be fed to the handlers again by wm0-replay (see replay.c),
+// without the X server.
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wm0.h"
+#include "places.h"
+
+static FILE *trace;        // Trace file, or NULL if not recording
+static uint64_t start;     // Time when the recording started
+
+// Get the current time in nanoseconds.
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Append a record to the trace.
+static void
+write_record(int kind, const void *data, uint32_t length)
+{
+    struct trace_record record = { 0 };
+
+    record.time = now() - start;
+    record.length = length;
+    record.kind = kind;
+    fwrite(&record, sizeof(record), 1, trace);
+    if (length > 0)
+        fwrite(data, length, 1, trace);
+}
+
+// Start recording to the given file.
+bool
+trace_open(const char *path)
+{
+    struct trace_header header = { TRACE_MAGIC };
+
+    trace = fopen(path, "wb");
+    if (trace == NULL)
+        return false;
+    // Records are buffered, and written when the WM becomes idle.
+    setvbuf(trace, NULL, _IOFBF, 1 << 16);
+
+    header.version = TRACE_VERSION;
+    header.root = wm.screen->root;
+    header.width = wm.screen->width_in_pixels;
+    header.height = wm.screen->height_in_pixels;
+    header.conf = wm.conf;
+    header.atoms = wm.atoms;
+    header.sync_event = wm.sync_event;
+    _Static_assert(sizeof(header.keycodes) == sizeof(wm.keycodes),
+        "keycodes in trace_header must have DESKTOPS elements");
+    memcpy(header.keycodes, wm.keycodes, sizeof(header.keycodes));
+    header.randr_event = wm.randr_event;
+    header.nmonitors = monitor_get(header.monitors);
+    header.frames = wm.frames;
+    header.compositing = wm.compositing;
+    header.damage_event = wm.damage_event;
+    header.overview_key = wm.overview_key;
+    header.layout_key = wm.layout_key;
+    header.places = places_enabled();
+    fwrite(&header, sizeof(header), 1, trace);
+
+    start = now();
+    return true;
+}
+
+// Record an event received from the X server.
+void
+trace_event(const xcb_generic_event_t *event)
+{
+    if (trace != NULL)
+        write_record(TRACE_EVENT, event, sizeof(*event));
+}
+
+// Record a reply received from the X server, and return it as is.
+// This is called by XCB_REQUEST_AND_REPLY.
+void *
+trace_reply(void *reply)
+{
+    xcb_generic_reply_t *r = reply;
+
+    if (trace != NULL)
+        write_record(TRACE_REPLY, r, r != NULL ? 32 + r->length * 4 : 0);
+    return reply;
+}
+
+// Write the buffered records to the file.
+void
+trace_flush(void)
+{
+    if (trace != NULL)
+        fflush(trace);
+}
+
+// Stop recording.
+void
+trace_close(void)
+{
+    if (trace != NULL) {
+        fclose(trace);
+        trace = NULL;
+    }
+}
+
+// Read the header of the trace.
+bool
+trace_read_header(FILE *fp, struct trace_header *header)
+{
+    return fread(header, sizeof(*header), 1, fp) == 1 &&
+        memcmp(header->magic, TRACE_MAGIC, 4) == 0 &&
+        header->version == TRACE_VERSION;
+}
+
+// Read the next record of the trace, and its data.
+// The data must be freed by the caller. It is NULL if the record has no data.
+// Return false if there are no more records.
+bool
+trace_read(FILE *fp, struct trace_record *record, void **data)
+{
+    *data = NULL;
+    if (fread(record, sizeof(*record), 1, fp) != 1)
+        return false;
+    if (record->length > 0) {
+        // Events are handled as xcb_generic_event_t, so allocate at least its
+        // size.
+        *data = calloc(1, record->length < sizeof(xcb_generic_event_t) ?
+            sizeof(xcb_generic_event_t) : record->length);
+        if (*data == NULL || fread(*data, record->length, 1, fp) != 1) {
+            free(*data);
+            *data = NULL;
+            return false;
+        }
+    }
+    return true;
+}
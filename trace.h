@@ -0,0 +1,62 @@
+#ifndef WM0_TRACE_H
+#define WM0_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <xcb/xcb.h>
+#include "atoms.h"
+#include "conf.h"
+#include "monitor.h"
+
+// A trace file consists of a header, followed by records.
+// Each record is a struct trace_record, followed by `length` bytes of data.
+// All values are in the native byte order of the recording machine.
+
+#define TRACE_MAGIC   "WM0T"
+#define TRACE_VERSION 11
+
+struct trace_header {
+    char magic[4];       // TRACE_MAGIC
+    uint32_t version;    // TRACE_VERSION
+    xcb_window_t root;   // Root window
+    uint16_t width;      // Width of the screen
+    uint16_t height;     // Height of the screen
+    struct conf conf;    // Configuration at the start of the recording
+    struct atoms atoms;  // Interned atoms
+    uint8_t sync_event;  // First event of XSync, or 0 if not available
+    xcb_keycode_t keycodes[9];  // Keys for the desktops (DESKTOPS in wm0.h)
+    uint8_t randr_event; // First event of RandR, or 0 if not available
+    uint8_t nmonitors;   // Number of monitors
+    bool frames;         // Whether windows are put into frames
+    bool compositing;    // Whether frames are composited by wm0
+    uint8_t damage_event;  // First event of Damage, or 0 if not compositing
+    xcb_keycode_t overview_key;  // Key for the overview, or 0
+    xcb_keycode_t layout_key;    // Key for the layouts, or 0
+    bool places;         // Whether positions are remembered (places.c)
+    struct monitor monitors[MAX_MONITORS];  // Monitors at the start
+};
+
+// Kind of records
+enum {
+    TRACE_EVENT,  // Event or error (xcb_generic_event_t)
+    TRACE_REPLY   // Reply, or no data if the request failed
+};
+
+struct trace_record {
+    uint64_t time;    // Nanoseconds since the start of the recording
+    uint32_t length;  // Length of the data
+    uint8_t kind;     // TRACE_EVENT or TRACE_REPLY
+    uint8_t pad[3];
+};
+
+bool trace_open(const char *path);
+void trace_event(const xcb_generic_event_t *event);
+void *trace_reply(void *reply);
+void trace_flush(void);
+void trace_close(void);
+
+bool trace_read_header(FILE *fp, struct trace_header *header);
+bool trace_read(FILE *fp, struct trace_record *record, void **data);
+
+#endif // WM0_TRACE_H
@@ -0,0 +1,186 @@
+// Watchdog of the event loop (enabled by `wm0 -w ms`).
+//
+// The event loop beats around each handler, storing the event and the XID
+// it is about, and the blocking macros in wm0.h store the request whose reply
+// is waited for. A thread checks the beats periodically, and reports a
+// handler running longer than the threshold once to the standard error,
+// with the event, the request, and a backtrace of the event loop taken by a
+// signal (with glibc).
+//
+// Only atomic stores are added to the event loop, and nothing at all if the
+// watchdog is not started.
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <xcb/xcb_event.h>  // for xcb_event_get_label
+#ifdef __GLIBC__
+#include <execinfo.h>
+#endif
+#include "wm0.h"
+#include "watchdog.h"
+
+#define BACKTRACE_SIGNAL SIGUSR1
+#define MAX_FRAMES       32  // Maximum depth of the backtrace
+
+static atomic_uint beat;       // Odd while a handler is running
+static _Atomic uint64_t since; // Time when the handler started (ns)
+static atomic_uint type;       // Type of the event being handled
+static atomic_uint xid;        // Window of the event, or 0
+static _Atomic(const char *) request;  // Request waited for, or NULL
+static atomic_bool stop;       // Whether the thread should stop
+static uint64_t threshold;     // Time to report a handler (ns)
+static pthread_t thread;
+static pthread_t loop;         // Thread running the event loop
+static bool running;
+
+static uint64_t now(void);
+static void report(uint64_t elapsed);
+static void *watchdog_thread(void *arg);
+#ifdef __GLIBC__
+static void dump_backtrace(int sig);
+#endif
+
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#ifdef __GLIBC__
+// Write the backtrace of the event loop, which receives the signal.
+// backtrace() was called once in advance, so that it does not load libgcc
+// in the signal handler.
+static void
+dump_backtrace(int sig)
+{
+    void *frames[MAX_FRAMES];
+    int n = backtrace(frames, MAX_FRAMES);
+
+    backtrace_symbols_fd(frames, n, STDERR_FILENO);
+}
+#endif
+
+// Report the stalled handler.
+static void
+report(uint64_t elapsed)
+{
+    unsigned int t = atomic_load(&type);
+    const char *r = atomic_load(&request);
+    const char *label = t == 0 ? "Error" : xcb_event_get_label(t);
+
+    // Events of extensions have no label.
+    if (label != NULL)
+        fprintf(stderr, "stall: %s", label);
+    else
+        fprintf(stderr, "stall: event %u", t);
+    fprintf(stderr, " on 0x%x for %llu ms", atomic_load(&xid),
+        (unsigned long long)(elapsed / 1000000));
+    if (r != NULL)
+        fprintf(stderr, ", waiting for the reply of %s", r);
+    fputc('\n', stderr);
+#ifdef __GLIBC__
+    pthread_kill(loop, BACKTRACE_SIGNAL);
+#endif
+}
+
+static void *
+watchdog_thread(void *arg)
+{
+    // Check four times within the threshold.
+    const struct timespec interval = {
+        threshold / 4 / 1000000000, threshold / 4 % 1000000000
+    };
+    unsigned int reported = 0;
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        unsigned int b = atomic_load(&beat);
+        uint64_t elapsed = now() - atomic_load(&since);
+
+        // A stall is reported once, however long it lasts.
+        if ((b & 1) && b != reported && elapsed >= threshold) {
+            reported = b;
+            report(elapsed);
+        }
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+// Start the thread to watch the event loop, which is the calling thread.
+// Handlers running longer than ms milliseconds are reported.
+bool
+watchdog_start(unsigned int ms)
+{
+#ifdef __GLIBC__
+    struct sigaction sa = { .sa_handler = dump_backtrace };
+    void *frame;
+
+    backtrace(&frame, 1);
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(BACKTRACE_SIGNAL, &sa, NULL);
+#endif
+    threshold = (uint64_t)ms * 1000000;
+    loop = pthread_self();
+    running = pthread_create(&thread, NULL, watchdog_thread, NULL) == 0;
+    return running;
+}
+
+// Beat before handling the event.
+void
+watchdog_begin(const xcb_generic_event_t *event)
+{
+    if (!running)
+        return;
+    atomic_store_explicit(&type, event->response_type & ~0x80,
+        memory_order_relaxed);
+    atomic_store_explicit(&xid, handle_event_window(event),
+        memory_order_relaxed);
+    atomic_store_explicit(&since, now(), memory_order_relaxed);
+    // The others are visible to the thread which sees this.
+    atomic_fetch_add(&beat, 1);
+}
+
+// Beat after handling the event.
+void
+watchdog_end(void)
+{
+    if (running)
+        atomic_fetch_add(&beat, 1);
+}
+
+// Note that the event loop is going to block for the reply of the request.
+void
+watchdog_wait(const char *name)
+{
+    if (running)
+        atomic_store_explicit(&request, name, memory_order_relaxed);
+}
+
+// Note that the reply has arrived, and return it.
+void *
+watchdog_reply(void *reply)
+{
+    if (running)
+        atomic_store_explicit(&request, NULL, memory_order_relaxed);
+    return reply;
+}
+
+// Stop the thread.
+void
+watchdog_stop(void)
+{
+    if (!running)
+        return;
+    atomic_store(&stop, true);
+    pthread_join(thread, NULL);
+    running = false;
+}
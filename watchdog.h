@@ -0,0 +1,14 @@
+#ifndef WM0_WATCHDOG_H
+#define WM0_WATCHDOG_H
+
+#include <stdbool.h>
+#include <xcb/xcb.h>
+
+bool watchdog_start(unsigned int ms);
+void watchdog_begin(const xcb_generic_event_t *event);
+void watchdog_end(void);
+void watchdog_wait(const char *request);
+void *watchdog_reply(void *reply);
+void watchdog_stop(void);
+
+#endif // WM0_WATCHDOG_H
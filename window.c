@@ -1,27 +1,74 @@
 #include <stdlib.h>
+#include <string.h>
+#include <xcb/xcbext.h>  // for xcb_poll_for_reply
 #include "wm0.h"
 #include "window.h"
+#include "snap.h"
+#include "rules.h"
+#include "monitor.h"
+#include "compositor.h"
+#include "tile.h"
+#include "places.h"
 
 static TAILQ_HEAD(windows, window) windows;  // List of windows
+static struct window_stack stack;            // Windows in stacking order
 static struct window *current;               // Currently focused window
 
+// Hash table of the windows by XID, chained by hash_next.
+// Events about windows are frequent (e.g. an UnmapNotify for every window on
+// a desktop switch), so the windows are not looked up linearly.
+static struct window **table;
+static size_t table_size;  // Number of buckets (power of 2, or 0)
+static size_t count;       // Number of windows
+static size_t hints_pending;  // Number of windows waiting for WM_NORMAL_HINTS
+
+static void set_hints(struct window *win, xcb_get_property_reply_t *r);
+static void apply_hints(struct window *win, uint16_t *w, uint16_t *h);
+static bool poll_hints(struct window *win);
+static void set_sync(struct window *win, xcb_get_property_reply_t *protocols,
+    xcb_get_property_reply_t *counter);
+static void send_sync_request(struct window *win);
+static size_t hash(xcb_window_t id);
+static void table_insert(struct window *win);
+static void table_remove(struct window *win);
+static void set_state(struct window *win, uint32_t state);
+static bool is_iconic(xcb_get_property_reply_t *r);
+static void apply_rule(struct window *win, xcb_get_property_reply_t *r,
+    xcb_get_property_reply_t *role, bool recall);
+static void set_leader(struct window *win, xcb_get_property_reply_t *r);
+static void place(struct window *win);
+static void create_frame(struct window *win, uint8_t depth,
+    const xcb_get_window_attributes_reply_t *attributes);
+static void destroy_frame(struct window *win, bool destroyed);
+static uint32_t border_pixel(const struct window *win, bool active);
+static void notify_geometry(struct window *win);
+static void move(struct window *win, int16_t x, int16_t y);
+static void restack(struct window *win, struct window *sibling, uint8_t mode);
+
+// Send GetProperty for the property of the window.
+#define GET_PROPERTY(id, property, type, length) \
+    (xcb_get_property_cookie_t) { XCB_SEND(wm.conn, get_property_unchecked, \
+        id, false, id, property, type, 0, length) }
+
 // Establish a passive grab of the mouse on the given window to receive a
 // ButtonPress event when the mouse button is pressed.
 static void
 grab_buttons(xcb_window_t id)
 {
-    uint8_t buttons[] = { BUTTON_MOVE, BUTTON_RESIZE, BUTTON_CLOSE };
+    uint8_t buttons[] = {
+        wm.conf.button_move, wm.conf.button_resize, wm.conf.button_close
+    };
     uint16_t modifiers[] = { 0, XCB_MOD_MASK_LOCK };
 
 #define GRAB_BUTTON(id, index, modifier) \
-    xcb_grab_button(wm.conn, false, id, XCB_EVENT_MASK_BUTTON_PRESS, \
-        XCB_GRAB_MODE_SYNC, XCB_GRAB_MODE_ASYNC, XCB_NONE, XCB_NONE, index, \
-        modifier)
+    XCB_SEND(wm.conn, grab_button, id, false, id, \
+        XCB_EVENT_MASK_BUTTON_PRESS, XCB_GRAB_MODE_SYNC, XCB_GRAB_MODE_ASYNC, \
+        XCB_NONE, XCB_NONE, index, modifier)
 
     for (int i = 0; i < LENGTH(buttons); ++i) {
         for (int j = 0; j < LENGTH(modifiers); ++j) {
             GRAB_BUTTON(id, buttons[i], modifiers[j]);
-            GRAB_BUTTON(id, buttons[i], MODKEY_MASK | modifiers[j]);
+            GRAB_BUTTON(id, buttons[i], wm.conf.modkey | modifiers[j]);
         }
     }
 
@@ -32,7 +79,174 @@ void
 window_init(void)
 {
     TAILQ_INIT(&windows);
+    TAILQ_INIT(&stack);
     current = NULL;
+    free(table);
+    table = NULL;
+    table_size = count = 0;
+    wm.desktop = 0;
+    tile_init();
+}
+
+// XIDs of a client are allocated sequentially from its resource base, so the
+// low bits are mixed with the high bits.
+static size_t
+hash(xcb_window_t id)
+{
+    return (id * 2654435761u) >> 8 & (table_size - 1);
+}
+
+// Add the window to the hash table, growing it as needed.
+// If memory is exhausted, the table is kept as is, and just gets slower.
+static void
+table_insert(struct window *win)
+{
+    if (count >= table_size) {
+        size_t old_size = table_size, size = old_size ? old_size * 2 : 64;
+        struct window **old = table, **new = calloc(size, sizeof(*new));
+
+        if (new != NULL) {
+            table = new;
+            table_size = size;
+            for (size_t i = 0; i < old_size; ++i) {
+                while (old[i] != NULL) {
+                    struct window *w = old[i];
+
+                    old[i] = w->hash_next;
+                    w->hash_next = table[hash(w->id)];
+                    table[hash(w->id)] = w;
+                }
+            }
+            free(old);
+        } else if (table == NULL) {
+            return;
+        }
+    }
+    win->hash_next = table[hash(win->id)];
+    table[hash(win->id)] = win;
+    ++count;
+}
+
+// Remove the window from the hash table.
+static void
+table_remove(struct window *win)
+{
+    if (table_size == 0)
+        return;
+    for (struct window **p = &table[hash(win->id)]; *p != NULL;
+        p = &(*p)->hash_next) {
+        if (*p == win) {
+            *p = win->hash_next;
+            --count;
+            return;
+        }
+    }
+}
+
+// Scan existing windows and manage them.
+void
+window_scan(void)
+{
+    xcb_query_tree_reply_t *tree;
+    xcb_window_t *children;
+    xcb_get_window_attributes_cookie_t *attributes;
+    xcb_get_property_cookie_t *states;
+    int n;
+    struct window *win = NULL;
+
+    PROBE(window_scan);
+
+    tree = XCB_REQUEST_AND_REPLY(wm.conn, query_tree, NULL, wm.screen->root);
+    if (tree == NULL)
+        return;
+    children = xcb_query_tree_children(tree);
+    n = xcb_query_tree_children_length(tree);
+    attributes = malloc(n * sizeof(*attributes));
+    states = malloc(n * sizeof(*states));
+    if (n > 0 && (attributes == NULL || states == NULL)) {
+        free(attributes);
+        free(states);
+        free(tree);
+        return;
+    }
+
+    // Send all requests before waiting for the replies. WM_STATE is only
+    // needed for unmapped windows, but asking it of every window saves
+    // another round trip for each unmapped one.
+    for (int i = 0; i < n; ++i) {
+        attributes[i] = (xcb_get_window_attributes_cookie_t) {
+            XCB_SEND(wm.conn, get_window_attributes_unchecked, children[i],
+                children[i])
+        };
+        states[i] = GET_PROPERTY(children[i], wm.atoms.wm_state,
+            wm.atoms.wm_state, 1);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        xcb_get_window_attributes_reply_t *r;
+        bool iconic;
+
+        r = XCB_REPLY(wm.conn, get_window_attributes, attributes[i], NULL);
+        iconic = is_iconic(XCB_REPLY(wm.conn, get_property, states[i], NULL));
+        if (r == NULL)
+            continue;
+
+        // Windows with override_redirect flag is not handled by
+        // non-compositing WM.
+        // In addition, we only manage mapped windows, and unmapped windows
+        // iconified by the previous WM, which are kept unmapped.
+        if (!r->override_redirect) {
+            if (r->map_state == XCB_MAP_STATE_VIEWABLE) {
+                struct window *w = window_manage(children[i], r, false);
+
+                // A rule may put the window on another desktop.
+                if (w != NULL && w->desktop != wm.desktop) {
+                    window_unmap(w);
+                } else if (w != NULL) {
+                    if (w->frame != w->id) {
+                        XCB_SEND(wm.conn, map_window, w->id, w->frame);
+                        compositor_map(w, true);
+                    }
+                    win = w;
+                }
+            } else if (iconic) {
+                struct window *icon = window_manage(children[i], r, false);
+
+                if (icon != NULL) {
+                    icon->iconic = true;
+                    tile_update(icon);
+                    set_state(icon, WM_STATE_ICONIC);
+                }
+            }
+        }
+        free(r);
+    }
+    free(attributes);
+    free(states);
+    free(tree);
+    // The windows are laid out at once, rather than as each is managed.
+    tile_arrange(wm.desktop);
+    window_focus(win);
+}
+
+// Check if the reply for WM_STATE tells the iconic state, and free the reply.
+static bool
+is_iconic(xcb_get_property_reply_t *r)
+{
+    bool iconic = r != NULL && r->format == 32 &&
+        xcb_get_property_value_length(r) >= 4 &&
+        *(uint32_t *)xcb_get_property_value(r) == WM_STATE_ICONIC;
+    free(r);
+    return iconic;
+}
+
+// Set WM_STATE of the window, which tells the client its state.
+static void
+set_state(struct window *win, uint32_t state)
+{
+    XCB_SEND(wm.conn, change_property, win->id, XCB_PROP_MODE_REPLACE,
+        win->id, wm.atoms.wm_state, wm.atoms.wm_state, 32, 2,
+        (const uint32_t []) { state, XCB_NONE });
 }
 
 struct window *
@@ -46,7 +260,9 @@ window_find(xcb_window_t id)
 {
     struct window *win;
 
-    TAILQ_FOREACH(win, &windows, link) {
+    if (table_size == 0)
+        return NULL;
+    for (win = table[hash(id)]; win != NULL; win = win->hash_next) {
         if (win->id == id)
             return win;
     }
@@ -54,19 +270,69 @@ window_find(xcb_window_t id)
 }
 
 struct window *
-window_manage(xcb_window_t id)
+window_bottom(void)
+{
+    return TAILQ_FIRST(&stack);
+}
+
+struct window *
+window_top(void)
+{
+    return TAILQ_LAST(&stack, window_stack);
+}
+
+// The attributes of the window are used to create the frame with its visual;
+// if NULL, the frame has the visual of the root.
+// If recall is true, the window is a new one, and is moved to the position
+// remembered for it (see places.c). Windows already placed when wm0 starts
+// keep their positions, since all windows of an application share one.
+struct window *
+window_manage(xcb_window_t id,
+    const xcb_get_window_attributes_reply_t *attributes, bool recall)
 {
     struct window *win;
+    xcb_get_geometry_cookie_t geometry;
+    xcb_get_property_cookie_t hints, class, transient_for, role = { 0 };
+    xcb_get_property_cookie_t protocols = { 0 }, counter = { 0 };
     xcb_get_geometry_reply_t *r;
+    xcb_get_property_reply_t *class_reply, *role_reply;
+
+    PROBE1(window_manage, id);
 
-    LOG("manage %x\n", id);
+    LOG(MSG_MANAGE, id);
 
     win = malloc(sizeof(struct window));
     if (win == NULL)
         return NULL;
 
-    r = XCB_REQUEST_AND_REPLY(wm.conn, get_geometry, NULL, id);
+    // Send all requests before waiting for the replies.
+    geometry = (xcb_get_geometry_cookie_t) {
+        XCB_SEND(wm.conn, get_geometry_unchecked, id, id)
+    };
+    hints = GET_PROPERTY(id, XCB_ATOM_WM_NORMAL_HINTS, XCB_ATOM_WM_SIZE_HINTS,
+        18);
+    class = GET_PROPERTY(id, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 64);
+    if (places_enabled())
+        role = GET_PROPERTY(id, wm.atoms.wm_window_role, XCB_ATOM_STRING, 16);
+    transient_for = GET_PROPERTY(id, XCB_ATOM_WM_TRANSIENT_FOR,
+        XCB_ATOM_WINDOW, 1);
+    if (wm.sync_event != 0) {
+        protocols = GET_PROPERTY(id, wm.atoms.wm_protocols, XCB_ATOM_ATOM, 32);
+        counter = GET_PROPERTY(id, wm.atoms.net_wm_sync_request_counter,
+            XCB_ATOM_CARDINAL, 1);
+    }
+
+    r = XCB_REPLY(wm.conn, get_geometry, geometry, NULL);
     if (r == NULL) {
+        xcb_discard_reply(wm.conn, hints.sequence);
+        xcb_discard_reply(wm.conn, class.sequence);
+        if (places_enabled())
+            xcb_discard_reply(wm.conn, role.sequence);
+        xcb_discard_reply(wm.conn, transient_for.sequence);
+        if (wm.sync_event != 0) {
+            xcb_discard_reply(wm.conn, protocols.sequence);
+            xcb_discard_reply(wm.conn, counter.sequence);
+        }
         free(win);
         return NULL;
     }
@@ -76,23 +342,503 @@ window_manage(xcb_window_t id)
     win->y = r->y;
     win->w = r->width;
     win->h = r->height;
+    win->bw = r->border_width;
+    win->hints_sequence = 0;
+    set_hints(win, XCB_REPLY(wm.conn, get_property, hints, NULL));
+    win->desktop = wm.desktop;
+    win->focus = true;
+    // The rule is applied after the window joins its group, since
+    // transients are not remembered (see apply_rule).
+    class_reply = XCB_REPLY(wm.conn, get_property, class, NULL);
+    role_reply = places_enabled() ?
+        XCB_REPLY(wm.conn, get_property, role, NULL) : NULL;
+    TAILQ_INIT(&win->transients);
+    set_leader(win, XCB_REPLY(wm.conn, get_property, transient_for, NULL));
+    apply_rule(win, class_reply, role_reply, recall);
+    place(win);
+
+    // Send the geometry changed by the rule or the placement at once.
+    if (wm.frames) {
+        create_frame(win, r->depth, attributes);
+    } else {
+        win->frame = win->id;
+        win->argb = r->depth == 32;
+        if (win->x != r->x || win->y != r->y || win->bw != r->border_width) {
+            XCB_SEND(wm.conn, configure_window, win->id, win->id,
+                XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+                XCB_CONFIG_WINDOW_BORDER_WIDTH,
+                (const uint32_t []) { win->x, win->y, win->bw });
+        }
+    }
+    compositor_add(win);
+    win->sync.counter = XCB_NONE;
+    win->sync.alarm = XCB_NONE;
+    win->sync.value = 0;
+    win->sync.waiting = false;
+    if (wm.sync_event != 0) {
+        set_sync(win, XCB_REPLY(wm.conn, get_property, protocols, NULL),
+            XCB_REPLY(wm.conn, get_property, counter, NULL));
+    }
 
     grab_buttons(win->id);
 
+    // Watch changes of the size hints and the sync counter.
+    XCB_SEND(wm.conn, change_window_attributes, win->id, win->id,
+        XCB_CW_EVENT_MASK,
+        (const uint32_t []) { XCB_EVENT_MASK_PROPERTY_CHANGE });
+
+    win->iconic = false;
+    win->ignore_unmap = 0;
+    set_state(win, WM_STATE_NORMAL);
+
     TAILQ_INSERT_HEAD(&windows, win, link);
+    TAILQ_INSERT_TAIL(&stack, win, stack_link);
+    table_insert(win);
+    snap_add(win);
+    tile_add(win);
 
     free(r);
     return win;
 }
 
+// Move the window to the position remembered for WM_CLASS and
+// WM_WINDOW_ROLE in the replies (see places.c) if recall is true, apply the
+// rule matching WM_CLASS, and free the replies. The rule takes precedence
+// over the remembered position. The geometry is only updated in win, and
+// sent by the caller.
+static void
+apply_rule(struct window *win, xcb_get_property_reply_t *r,
+    xcb_get_property_reply_t *role, bool recall)
+{
+    char class[258] = "";
+    const char *instance = class;
+    struct rule rule;
+    int len;
+
+    // WM_CLASS consists of the instance and the class, both terminated by
+    // NUL. The buffer always ends with two NULs, even if the value is broken.
+    if (r != NULL && r->format == 8) {
+        len = MIN(xcb_get_property_value_length(r), (int)sizeof(class) - 2);
+        memcpy(class, xcb_get_property_value(r), len);
+        class[len] = '\0';
+    }
+    free(r);
+
+    // Transients share the class of their leader, but not its position.
+    win->place_key = 0;
+    if (win->leader == NULL) {
+        bool has_role = role != NULL && role->format == 8;
+
+        win->place_key = places_key(instance, class + strlen(class) + 1,
+            has_role ? xcb_get_property_value(role) : "",
+            has_role ? xcb_get_property_value_length(role) : 0);
+        if (recall)
+            places_recall(win);
+    }
+    free(role);
+
+    rule = rules_match(instance, class + strlen(class) + 1);
+
+    if (rule.set & RULE_DESKTOP)
+        win->desktop = rule.desktop;
+    if (rule.set & RULE_FOCUS)
+        win->focus = rule.focus;
+    if (rule.set & RULE_POSITION) {
+        win->x = rule.x;
+        win->y = rule.y;
+    }
+    if (rule.set & RULE_BORDER)
+        win->bw = rule.border;
+}
+
+// Add the window to the group of the window in the reply for
+// WM_TRANSIENT_FOR, and free the reply.
+// Groups are kept flat: a transient for a transient joins the group of its
+// leader, so that the whole group is found from any member in O(1).
+static void
+set_leader(struct window *win, xcb_get_property_reply_t *r)
+{
+    struct window *leader = NULL;
+
+    if (r != NULL && r->format == 32 && xcb_get_property_value_length(r) >= 4)
+        leader = window_find(*(xcb_window_t *)xcb_get_property_value(r));
+    free(r);
+
+    win->leader = NULL;
+    if (leader == NULL || leader == win)
+        return;
+    if (leader->leader != NULL)
+        leader = leader->leader;
+    win->leader = leader;
+    TAILQ_INSERT_TAIL(&leader->transients, win, group_link);
+}
+
+// Put the window into a new frame, which takes over the geometry and the
+// border of the window. The frame is mapped by the caller.
+// The frame has the depth and the visual of the window, so that windows with
+// an alpha channel keep it. The compositor only handles the visual of the
+// root, so the frames have it while compositing.
+static void
+create_frame(struct window *win, uint8_t depth,
+    const xcb_get_window_attributes_reply_t *attributes)
+{
+    xcb_visualid_t visual = XCB_COPY_FROM_PARENT;
+    xcb_colormap_t colormap = XCB_COPY_FROM_PARENT;
+
+    // A window whose colormap was freed has none to give to the frame.
+    if (!wm.compositing && attributes != NULL &&
+        attributes->visual != wm.screen->root_visual &&
+        attributes->colormap != XCB_NONE) {
+        visual = attributes->visual;
+        colormap = attributes->colormap;
+    } else {
+        depth = XCB_COPY_FROM_PARENT;
+    }
+    win->argb = depth == 32;
+
+    win->frame = xcb_generate_id(wm.conn);
+    XCB_SEND(wm.conn, create_window, win->id, depth, win->frame,
+        wm.screen->root, win->x, win->y, win->w, win->h, win->bw,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT, visual,
+        XCB_CW_BORDER_PIXEL | XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK |
+        XCB_CW_COLORMAP,
+        (const uint32_t []) {
+            border_pixel(win, false),
+            true,  // Not to be managed by a WM started later
+            XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT |  // for the window inside
+            XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY,
+            colormap
+        });
+
+    // The window is put back to the root by the server if the WM dies.
+    XCB_SEND(wm.conn, change_save_set, win->id, XCB_SET_MODE_INSERT, win->id);
+    XCB_SEND(wm.conn, configure_window, win->id, win->id,
+        XCB_CONFIG_WINDOW_BORDER_WIDTH, (const uint32_t []) { 0 });
+    XCB_SEND(wm.conn, reparent_window, win->id, win->id, win->frame, 0, 0);
+}
+
+// Put the window back to the root, where the frame is, and destroy the
+// frame. If the window is already destroyed, only the frame is destroyed.
+static void
+destroy_frame(struct window *win, bool destroyed)
+{
+    if (!destroyed) {
+        XCB_SEND(wm.conn, reparent_window, win->id, win->id, wm.screen->root,
+            win->x, win->y);
+        XCB_SEND(wm.conn, configure_window, win->id, win->id,
+            XCB_CONFIG_WINDOW_BORDER_WIDTH, (const uint32_t []) { win->bw });
+        XCB_SEND(wm.conn, change_save_set, win->id, XCB_SET_MODE_DELETE,
+            win->id);
+    }
+    XCB_SEND(wm.conn, destroy_window, win->id, win->frame);
+}
+
+// Return the pixel of the border of the frame. The pixels of the colormap of
+// the root have no alpha, which makes the border of 32-bit frames transparent.
+static uint32_t
+border_pixel(const struct window *win, bool active)
+{
+    uint32_t pixel = active ? wm.border_active : wm.border_inactive;
+
+    return win->argb ? pixel | 0xff000000 : pixel;
+}
+
+// Keep the window reachable: if its top-left corner is not on any monitor
+// (e.g. it was placed on a monitor which is unplugged), move it into the
+// nearest monitor, as far as it fits.
+static void
+place(struct window *win)
+{
+    const struct monitor *m = monitor_at(win->x, win->y);
+    int w = win->w + 2 * win->bw, h = win->h + 2 * win->bw;
+
+    if (monitor_contains(m, win->x, win->y))
+        return;
+    win->x = MAX(m->x, MIN(win->x, m->x + m->w - w));
+    win->y = MAX(m->y, MIN(win->y, m->y + m->h - h));
+}
+
+// Set the size hints from the reply for WM_NORMAL_HINTS, and free the reply.
+static void
+set_hints(struct window *win, xcb_get_property_reply_t *r)
+{
+    // Flags of WM_SIZE_HINTS (ICCCM 4.1.2.3)
+    enum {
+        P_MIN_SIZE = 1 << 4,
+        P_MAX_SIZE = 1 << 5,
+        P_RESIZE_INC = 1 << 6,
+        P_ASPECT = 1 << 7,
+        P_BASE_SIZE = 1 << 8
+    };
+    // Indices of the fields of WM_SIZE_HINTS
+    enum {
+        FLAGS = 0, MIN_W = 5, MIN_H, MAX_W, MAX_H, INC_W, INC_H,
+        MIN_ASPECT_NUM, MIN_ASPECT_DEN, MAX_ASPECT_NUM, MAX_ASPECT_DEN,
+        BASE_W, BASE_H
+    };
+    uint32_t v[18] = { 0 };
+
+    if (r != NULL && r->format == 32) {
+        memcpy(v, xcb_get_property_value(r),
+            MIN(xcb_get_property_value_length(r), sizeof(v)));
+    }
+    free(r);
+
+    memset(&win->hints, 0, sizeof(win->hints));
+    if (v[FLAGS] & P_MIN_SIZE) {
+        win->hints.min_w = v[MIN_W];
+        win->hints.min_h = v[MIN_H];
+    }
+    if (v[FLAGS] & P_MAX_SIZE) {
+        win->hints.max_w = v[MAX_W];
+        win->hints.max_h = v[MAX_H];
+    }
+    if (v[FLAGS] & P_RESIZE_INC) {
+        win->hints.inc_w = v[INC_W];
+        win->hints.inc_h = v[INC_H];
+    }
+    if ((v[FLAGS] & P_ASPECT) && v[MIN_ASPECT_NUM] && v[MAX_ASPECT_DEN]) {
+        win->hints.min_aspect = (float)v[MIN_ASPECT_DEN] / v[MIN_ASPECT_NUM];
+        win->hints.max_aspect = (float)v[MAX_ASPECT_NUM] / v[MAX_ASPECT_DEN];
+    }
+    if (v[FLAGS] & P_BASE_SIZE) {
+        win->hints.base_w = v[BASE_W];
+        win->hints.base_h = v[BASE_H];
+    } else {
+        // The minimum size is used as the base size if not specified.
+        win->hints.base_w = win->hints.min_w;
+        win->hints.base_h = win->hints.min_h;
+    }
+    if (!(v[FLAGS] & P_MIN_SIZE)) {
+        // And vice versa.
+        win->hints.min_w = win->hints.base_w;
+        win->hints.min_h = win->hints.base_h;
+    }
+}
+
+// Adjust the size of the window according to the size hints.
+static void
+apply_hints(struct window *win, uint16_t *w, uint16_t *h)
+{
+    bool base_is_min;
+    int bw, bh, cw = *w, ch = *h;
+
+    // Take the new hints if they have arrived, or keep the old ones.
+    poll_hints(win);
+    // See the last two sentences in ICCCM 4.1.2.3.
+    base_is_min = win->hints.base_w == win->hints.min_w &&
+        win->hints.base_h == win->hints.min_h;
+    bw = win->hints.base_w;
+    bh = win->hints.base_h;
+
+    if (!base_is_min) {
+        cw -= bw;
+        ch -= bh;
+    }
+    if (win->hints.min_aspect > 0 && win->hints.max_aspect > 0 && cw > 0 &&
+        ch > 0) {
+        if (win->hints.max_aspect < (float)cw / ch)
+            cw = ch * win->hints.max_aspect + 0.5;
+        else if (win->hints.min_aspect < (float)ch / cw)
+            ch = cw * win->hints.min_aspect + 0.5;
+    }
+    if (base_is_min) {
+        cw -= bw;
+        ch -= bh;
+    }
+    if (win->hints.inc_w > 0 && cw > 0)
+        cw -= cw % win->hints.inc_w;
+    if (win->hints.inc_h > 0 && ch > 0)
+        ch -= ch % win->hints.inc_h;
+
+    cw = MAX(cw + bw, MAX(win->hints.min_w, 1));
+    ch = MAX(ch + bh, MAX(win->hints.min_h, 1));
+    if (win->hints.max_w > 0)
+        cw = MIN(cw, win->hints.max_w);
+    if (win->hints.max_h > 0)
+        ch = MIN(ch, win->hints.max_h);
+    *w = cw;
+    *h = ch;
+}
+
+// Fetch the size hints again, since they are changed.
+void
+window_update_hints(struct window *win)
+{
+    PROBE1(window_update_hints, win->id);
+
+    if (win->hints_sequence != 0)
+        xcb_discard_reply(wm.conn, win->hints_sequence);
+    else
+        ++hints_pending;
+    win->hints_sequence = GET_PROPERTY(win->id, XCB_ATOM_WM_NORMAL_HINTS,
+        XCB_ATOM_WM_SIZE_HINTS, 18).sequence;
+}
+
+// Take the reply for WM_NORMAL_HINTS requested by window_update_hints(), if
+// it has arrived. Return false if it is still pending.
+static bool
+poll_hints(struct window *win)
+{
+    xcb_get_property_reply_t *r;
+    xcb_generic_error_t *e;
+
+    if (win->hints_sequence == 0)
+        return true;
+    if (!xcb_poll_for_reply(wm.conn, win->hints_sequence, (void **)&r, &e))
+        return false;
+    win->hints_sequence = 0;
+    --hints_pending;
+    free(e);
+    set_hints(win, trace_reply(r));
+    return true;
+}
+
+// Take the replies for WM_NORMAL_HINTS which have arrived, without blocking.
+// This is called when the event loop runs out of events.
+void
+window_poll_hints(void)
+{
+    struct window *win;
+
+    if (hints_pending == 0)
+        return;
+    TAILQ_FOREACH(win, &windows, link)
+        poll_hints(win);
+}
+
+// Set the sync counter from the replies for WM_PROTOCOLS and
+// _NET_WM_SYNC_REQUEST_COUNTER, and free the replies.
+// The counter is used only if the client supports _NET_WM_SYNC_REQUEST.
+static void
+set_sync(struct window *win, xcb_get_property_reply_t *protocols,
+    xcb_get_property_reply_t *counter)
+{
+    xcb_sync_counter_t c = XCB_NONE;
+
+    if (protocols != NULL && protocols->format == 32 && counter != NULL &&
+        counter->format == 32 && xcb_get_property_value_length(counter) >= 4) {
+        xcb_atom_t *atoms = xcb_get_property_value(protocols);
+        int n = xcb_get_property_value_length(protocols) / 4;
+
+        for (int i = 0; i < n; ++i) {
+            if (atoms[i] == wm.atoms.net_wm_sync_request)
+                c = *(uint32_t *)xcb_get_property_value(counter);
+        }
+    }
+    free(protocols);
+    free(counter);
+
+    if (c != win->sync.counter && win->sync.alarm != XCB_NONE) {
+        XCB_SEND(wm.conn, sync_destroy_alarm, win->id, win->sync.alarm);
+        win->sync.alarm = XCB_NONE;
+    }
+    win->sync.counter = c;
+    win->sync.waiting = false;
+}
+
+// Fetch the sync counter again, since WM_PROTOCOLS or the counter is changed.
+void
+window_update_sync(struct window *win)
+{
+    xcb_get_property_cookie_t protocols, counter;
+
+    PROBE1(window_update_sync, win->id);
+
+    if (wm.sync_event == 0)
+        return;
+    protocols = GET_PROPERTY(win->id, wm.atoms.wm_protocols, XCB_ATOM_ATOM, 32);
+    counter = GET_PROPERTY(win->id, wm.atoms.net_wm_sync_request_counter,
+        XCB_ATOM_CARDINAL, 1);
+    set_sync(win, XCB_REPLY(wm.conn, get_property, protocols, NULL),
+        XCB_REPLY(wm.conn, get_property, counter, NULL));
+}
+
+// Ask the client to set the counter to the next value when it has redrawn
+// the window for the following ConfigureWindow (_NET_WM_SYNC_REQUEST), and
+// set the alarm to receive AlarmNotify at that time.
+static void
+send_sync_request(struct window *win)
+{
+    xcb_client_message_event_t ev = {
+        .response_type = XCB_CLIENT_MESSAGE,
+        .format = 32,
+        .window = win->id,
+        .type = wm.atoms.wm_protocols,
+    };
+    uint32_t values[8];
+
+    ++win->sync.value;
+    ev.data.data32[0] = wm.atoms.net_wm_sync_request;
+    ev.data.data32[1] = XCB_CURRENT_TIME;
+    ev.data.data32[2] = win->sync.value & 0xffffffff;
+    ev.data.data32[3] = win->sync.value >> 32;
+    XCB_SEND(wm.conn, send_event, win->id, false, win->id,
+        XCB_EVENT_MASK_NO_EVENT, (const char *)&ev);
+
+    // The alarm is created on the first resize, and only its value is changed
+    // afterwards. With the delta of 0, it fires once for each value.
+    // values must be in the same order as XCB_SYNC_CA_* are defined.
+    if (win->sync.alarm == XCB_NONE) {
+        win->sync.alarm = xcb_generate_id(wm.conn);
+        values[0] = win->sync.counter;
+        values[1] = XCB_SYNC_VALUETYPE_ABSOLUTE;
+        values[2] = win->sync.value >> 32;
+        values[3] = win->sync.value & 0xffffffff;
+        values[4] = XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON;
+        values[5] = values[6] = 0;  // Delta
+        values[7] = true;           // Events
+        XCB_SEND(wm.conn, sync_create_alarm, win->id, win->sync.alarm,
+            XCB_SYNC_CA_COUNTER | XCB_SYNC_CA_VALUE_TYPE | XCB_SYNC_CA_VALUE |
+            XCB_SYNC_CA_TEST_TYPE | XCB_SYNC_CA_DELTA | XCB_SYNC_CA_EVENTS,
+            values);
+    } else {
+        values[0] = win->sync.value >> 32;
+        values[1] = win->sync.value & 0xffffffff;
+        XCB_SEND(wm.conn, sync_change_alarm, win->id, win->sync.alarm,
+            XCB_SYNC_CA_VALUE, values);
+    }
+    win->sync.waiting = true;
+}
+
+// If destroyed is true, the window is already destroyed, and only the
+// requests for the frame are sent.
 void
-window_unmanage(struct window *win)
+window_unmanage(struct window *win, bool destroyed)
 {
-    LOG("unmanage %x\n", win->id);
+    struct window *t;
+
+    PROBE1(window_unmanage, win->id);
+
+    LOG(MSG_UNMANAGE, win->id);
 
     if (win == current)
         window_focus(NULL);
+    if (win->sync.alarm != XCB_NONE)
+        XCB_SEND(wm.conn, sync_destroy_alarm, win->id, win->sync.alarm);
+    if (win->hints_sequence != 0) {
+        xcb_discard_reply(wm.conn, win->hints_sequence);
+        --hints_pending;
+    }
+
+    // The transients are left alone, rather than being unmanaged with it.
+    if (win->leader != NULL)
+        TAILQ_REMOVE(&win->leader->transients, win, group_link);
+    while ((t = TAILQ_FIRST(&win->transients)) != NULL) {
+        TAILQ_REMOVE(&win->transients, t, group_link);
+        t->leader = NULL;
+    }
+
+    if (win->frame != win->id) {
+        compositor_remove(win);
+        destroy_frame(win, destroyed);
+    }
 
+    places_store(win);
+    snap_remove(win);
+    tile_remove(win);
+    table_remove(win);
+    TAILQ_REMOVE(&stack, win, stack_link);
     TAILQ_REMOVE(&windows, win, link);
     free(win);
 }
@@ -100,36 +846,459 @@ window_unmanage(struct window *win)
 void
 window_unmanage_all(void)
 {
+    PROBE(window_unmanage_all);
+
     while (TAILQ_FIRST(&windows) != NULL)
-        window_unmanage(TAILQ_FIRST(&windows));
+        window_unmanage(TAILQ_FIRST(&windows), false);
 }
 
+// Re-establish the passive grabs of all windows.
+// This is called when the button assignment is changed.
+void
+window_regrab_buttons(void)
+{
+    struct window *win;
+
+    PROBE(window_regrab_buttons);
+
+    TAILQ_FOREACH(win, &windows, link) {
+        XCB_SEND(wm.conn, ungrab_button, win->id, XCB_BUTTON_INDEX_ANY, win->id,
+            XCB_MOD_MASK_ANY);
+        grab_buttons(win->id);
+    }
+}
+
+// Repaint the border of windows.
+// This is called when the border colors are changed.
+void
+window_repaint_borders(bool active, bool inactive)
+{
+    struct window *win;
+
+    PROBE2(window_repaint_borders, active, inactive);
+
+    TAILQ_FOREACH(win, &windows, link) {
+        if (win == current ? active : inactive) {
+            XCB_SEND(wm.conn, change_window_attributes, win->id, win->frame,
+                XCB_CW_BORDER_PIXEL,
+                (const uint32_t []) { border_pixel(win, win == current) });
+        }
+    }
+}
+
+// Move the window, and its transients by the same offset.
 void
 window_move(struct window *win, int16_t x, int16_t y)
 {
+    int dx = x - win->x, dy = y - win->y;
+    struct window *t;
+
+    PROBE3(window_move, win->id, x, y);
+
+    move(win, x, y);
+
+    // Transients follow their leader.
+    TAILQ_FOREACH(t, &win->transients, group_link)
+        move(t, t->x + dx, t->y + dy);
+}
+
+static void
+move(struct window *win, int16_t x, int16_t y)
+{
+    struct window old = *win;
+
     win->x = x;
     win->y = y;
-    xcb_configure_window(wm.conn, win->id,
+    snap_update(win, &old);
+    compositor_update(win, &old);
+    XCB_SEND(wm.conn, configure_window, win->id, win->frame,
         XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
         (const uint32_t []) { x, y });
 }
 
+// Resize the window, respecting its size hints.
+// Nothing is sent if the size is not changed after applying the hints, e.g.
+// while a terminal is resized by less than a character cell.
+// If the client supports _NET_WM_SYNC_REQUEST, win->sync.waiting is set
+// until it redraws the window.
 void
 window_resize(struct window *win, uint16_t w, uint16_t h)
 {
+    struct window old;
+
+    PROBE3(window_resize, win->id, w, h);
+
+    apply_hints(win, &w, &h);
+    if (w == win->w && h == win->h)
+        return;
+
+    if (win->sync.counter != XCB_NONE)
+        send_sync_request(win);
+
+    old = *win;
     win->w = w;
     win->h = h;
-    xcb_configure_window(wm.conn, win->id,
+    snap_update(win, &old);
+    compositor_update(win, &old);
+    XCB_SEND(wm.conn, configure_window, win->id, win->id,
         XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
         (const uint32_t []) { w, h });
+    if (win->frame != win->id) {
+        XCB_SEND(wm.conn, configure_window, win->id, win->frame,
+            XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+            (const uint32_t []) { w, h });
+    }
 }
 
+// Move and resize the window at once, respecting its size hints, as the
+// layouts do. Only what is changed is sent, and nothing at all if the
+// geometry is the same. Transients follow the position as in window_move().
+void
+window_move_resize(struct window *win, int16_t x, int16_t y, uint16_t w,
+    uint16_t h)
+{
+    struct window old = *win, *t;
+    uint32_t values[4];
+    uint16_t mask = 0;
+    int i = 0;
+
+    PROBE5(window_move_resize, win->id, x, y, w, h);
+
+    apply_hints(win, &w, &h);
+    // values must be in the same order as XCB_CONFIG_* are defined.
+    if (x != win->x) {
+        mask |= XCB_CONFIG_WINDOW_X;
+        values[i++] = win->x = x;
+    }
+    if (y != win->y) {
+        mask |= XCB_CONFIG_WINDOW_Y;
+        values[i++] = win->y = y;
+    }
+    if (w != win->w) {
+        mask |= XCB_CONFIG_WINDOW_WIDTH;
+        values[i++] = win->w = w;
+    }
+    if (h != win->h) {
+        mask |= XCB_CONFIG_WINDOW_HEIGHT;
+        values[i++] = win->h = h;
+    }
+    if (mask == 0)
+        return;
+
+    snap_update(win, &old);
+    compositor_update(win, &old);
+    XCB_SEND(wm.conn, configure_window, win->id, win->frame, mask, values);
+    if (win->frame != win->id) {
+        if (win->w != old.w || win->h != old.h) {
+            XCB_SEND(wm.conn, configure_window, win->id, win->id,
+                XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+                (const uint32_t []) { win->w, win->h });
+        }
+        if (win->x != old.x || win->y != old.y)
+            notify_geometry(win);
+    }
+    if (win->x != old.x || win->y != old.y) {
+        TAILQ_FOREACH(t, &win->transients, group_link)
+            move(t, t->x + win->x - old.x, t->y + win->y - old.y);
+    }
+}
+
+// Configure the window in a frame as the client requested: the position,
+// the border and the stacking apply to the frame, and the size to both.
+// The client is told the result by a synthetic ConfigureNotify, since
+// moving the frame does not send it the real one (ICCCM 4.1.5).
+// The geometry of a tiled window is kept, and only told to the client.
+void
+window_configure(struct window *win, const xcb_configure_request_event_t *ev)
+{
+    struct window old = *win, *sibling = NULL;
+    uint32_t values[7];
+    uint16_t mask = ev->value_mask & (XCB_CONFIG_WINDOW_X |
+        XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH |
+        XCB_CONFIG_WINDOW_HEIGHT | XCB_CONFIG_WINDOW_BORDER_WIDTH |
+        XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE);
+    int i = 0;
+
+    PROBE2(window_configure, win->id, ev->value_mask);
+
+    if (tile_fixed(win))
+        mask &= XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE;
+
+    // values must be in the same order as XCB_CONFIG_* are defined.
+    if (mask & XCB_CONFIG_WINDOW_X)
+        values[i++] = win->x = ev->x;
+    if (mask & XCB_CONFIG_WINDOW_Y)
+        values[i++] = win->y = ev->y;
+    if (mask & XCB_CONFIG_WINDOW_WIDTH)
+        values[i++] = win->w = ev->width;
+    if (mask & XCB_CONFIG_WINDOW_HEIGHT)
+        values[i++] = win->h = ev->height;
+    if (mask & XCB_CONFIG_WINDOW_BORDER_WIDTH)
+        values[i++] = win->bw = ev->border_width;
+    if (mask & XCB_CONFIG_WINDOW_SIBLING) {
+        // Siblings of the frame are frames.
+        sibling = window_find(ev->sibling);
+        values[i++] = sibling != NULL ? sibling->frame : ev->sibling;
+    }
+    if (mask & XCB_CONFIG_WINDOW_STACK_MODE)
+        values[i++] = ev->stack_mode;
+    if (mask != 0)
+        XCB_SEND(wm.conn, configure_window, win->id, win->frame, mask, values);
+    snap_update(win, &old);
+    compositor_update(win, &old);
+    if (mask & XCB_CONFIG_WINDOW_STACK_MODE)
+        restack(win, sibling, ev->stack_mode);
+
+    if (win->w != old.w || win->h != old.h) {
+        XCB_SEND(wm.conn, configure_window, win->id, win->id,
+            XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+            (const uint32_t []) { win->w, win->h });
+    }
+    notify_geometry(win);
+}
+
+// Keep the stacking order of the windows after restacking the frame with
+// the stack mode, relative to the sibling if not NULL.
+// TopIf, BottomIf and Opposite depend on the overlap with the other windows,
+// which is not worth computing here, so they are not followed.
+static void
+restack(struct window *win, struct window *sibling, uint8_t mode)
+{
+    if ((mode != XCB_STACK_MODE_ABOVE && mode != XCB_STACK_MODE_BELOW) ||
+        sibling == win)
+        return;
+    TAILQ_REMOVE(&stack, win, stack_link);
+    if (mode == XCB_STACK_MODE_ABOVE && sibling != NULL)
+        TAILQ_INSERT_AFTER(&stack, sibling, win, stack_link);
+    else if (mode == XCB_STACK_MODE_ABOVE)
+        TAILQ_INSERT_TAIL(&stack, win, stack_link);
+    else if (sibling != NULL)
+        TAILQ_INSERT_BEFORE(sibling, win, stack_link);
+    else
+        TAILQ_INSERT_HEAD(&stack, win, stack_link);
+    compositor_expose(win);
+}
+
+// Tell the client the position of its window after it was moved in a frame,
+// by a synthetic ConfigureNotify (ICCCM 4.2.3). Its transients are told as
+// well, since they move with it. Nothing is sent if frames are not used.
+// This is called when a drag ends, rather than for each motion, so that
+// clients do not redo their layout while the window is being dragged.
+void
+window_notify_moved(struct window *win)
+{
+    struct window *t;
+
+    PROBE1(window_notify_moved, win->id);
+
+    if (win->frame == win->id)
+        return;
+    notify_geometry(win);
+    TAILQ_FOREACH(t, &win->transients, group_link)
+        notify_geometry(t);
+}
+
+// Send a synthetic ConfigureNotify with the geometry of the window in the
+// frame, relative to the root.
+static void
+notify_geometry(struct window *win)
+{
+    // Events are sent as 32 bytes, which is longer than the structure.
+    union {
+        xcb_configure_notify_event_t event;
+        char bytes[32];
+    } ev = {
+        .event = {
+            .response_type = XCB_CONFIGURE_NOTIFY,
+            .event = win->id,
+            .window = win->id,
+            .above_sibling = XCB_NONE,
+            .x = win->x + win->bw,
+            .y = win->y + win->bw,
+            .width = win->w,
+            .height = win->h,
+            .border_width = 0,
+            .override_redirect = false,
+        },
+    };
+
+    XCB_SEND(wm.conn, send_event, win->id, false, win->id,
+        XCB_EVENT_MASK_STRUCTURE_NOTIFY, ev.bytes);
+}
+
+// Map the window, which was unmapped by window_unmap().
+void
+window_map(struct window *win)
+{
+    PROBE1(window_map, win->id);
+
+    XCB_SEND(wm.conn, map_window, win->id, win->id);
+    if (win->frame != win->id) {
+        XCB_SEND(wm.conn, map_window, win->id, win->frame);
+        compositor_map(win, true);
+    }
+}
+
+// Unmap the window, without unmanaging it.
+// The UnmapNotify caused by this is ignored by handle_unmap_notify().
+void
+window_unmap(struct window *win)
+{
+    PROBE1(window_unmap, win->id);
+
+    // Unmap the frame first, so that it is not seen empty.
+    if (win->frame != win->id) {
+        XCB_SEND(wm.conn, unmap_window, win->id, win->frame);
+        compositor_map(win, false);
+    }
+    ++win->ignore_unmap;
+    XCB_SEND(wm.conn, unmap_window, win->id, win->id);
+}
+
+// Switch to the desktop.
+// Nothing is waited for, so the requests to unmap the windows on the current
+// desktop and map the ones on the new desktop are sent at once by the next
+// flush.
+void
+window_switch_desktop(uint8_t desktop)
+{
+    struct window *win, *first = NULL;
+
+    PROBE1(window_switch_desktop, desktop);
+
+    if (desktop == wm.desktop)
+        return;
+
+    LOG(MSG_DESKTOP, desktop);
+
+    // Lay out the windows before they are shown.
+    tile_arrange(desktop);
+    TAILQ_FOREACH(win, &windows, link) {
+        if (win->iconic)
+            continue;
+        if (win->desktop == desktop) {
+            window_map(win);
+            if (first == NULL)
+                first = win;
+        } else if (win->desktop == wm.desktop) {
+            window_unmap(win);
+        }
+    }
+    wm.desktop = desktop;
+
+    // Focus the most recently managed window on the new desktop.
+    window_focus(first);
+}
+
+// Move the window to the desktop.
+void
+window_send_to_desktop(struct window *win, uint8_t desktop)
+{
+    PROBE2(window_send_to_desktop, win->id, desktop);
+
+    if (desktop == win->desktop)
+        return;
+
+    if (win->iconic) {
+        // Iconified windows stay unmapped anyway.
+    } else if (win->desktop == wm.desktop) {
+        if (win == current)
+            window_focus(NULL);
+        window_unmap(win);
+    } else if (desktop == wm.desktop) {
+        window_map(win);
+    }
+    tile_remove(win);
+    win->desktop = desktop;
+    tile_add(win);
+}
+
+// Iconify the window.
+// The window is only unmapped, so it keeps everything including the passive
+// grabs, and can be restored without managing it again.
+void
+window_iconify(struct window *win)
+{
+    PROBE1(window_iconify, win->id);
+
+    if (win->iconic)
+        return;
+
+    LOG(MSG_ICONIFY, win->id);
+
+    if (win == current)
+        window_focus(NULL);
+    if (win->desktop == wm.desktop)
+        window_unmap(win);
+    win->iconic = true;
+    tile_update(win);
+    set_state(win, WM_STATE_ICONIC);
+}
+
+// Restore the iconified window.
+void
+window_restore(struct window *win)
+{
+    PROBE1(window_restore, win->id);
+
+    if (!win->iconic)
+        return;
+
+    LOG(MSG_RESTORE, win->id);
+
+    if (win->desktop == wm.desktop)
+        window_map(win);
+    win->iconic = false;
+    tile_update(win);
+    set_state(win, WM_STATE_NORMAL);
+}
+
+// Map the windows on the other desktops and the iconified windows, so that
+// they are not lost after the WM exits.
+void
+window_show_all(void)
+{
+    struct window *win;
+
+    PROBE(window_show_all);
+
+    TAILQ_FOREACH(win, &windows, link) {
+        if (win->desktop != wm.desktop || win->iconic) {
+            window_map(win);
+            set_state(win, WM_STATE_NORMAL);
+        }
+    }
+}
+
+// Raise the window with the other windows of its group.
 void
 window_raise(struct window *win)
 {
-    xcb_configure_window(wm.conn, win->id,
+    struct window *leader = win->leader != NULL ? win->leader : win;
+    struct window *below = leader, *t;
+
+    PROBE1(window_raise, win->id);
+
+    // The raised transient goes to the top of its group.
+    if (win != leader) {
+        TAILQ_REMOVE(&leader->transients, win, group_link);
+        TAILQ_INSERT_TAIL(&leader->transients, win, group_link);
+    }
+
+    // Raise the leader to the top, and then stack each transient right above
+    // the previous one. Stacking relative to a sibling lets the server move
+    // the window by one step, rather than searching the stack again.
+    XCB_SEND(wm.conn, configure_window, leader->id, leader->frame,
         XCB_CONFIG_WINDOW_STACK_MODE,
         (const uint32_t []) { XCB_STACK_MODE_ABOVE });
+    restack(leader, NULL, XCB_STACK_MODE_ABOVE);
+    TAILQ_FOREACH(t, &leader->transients, group_link) {
+        XCB_SEND(wm.conn, configure_window, t->id, t->frame,
+            XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE,
+            (const uint32_t []) { below->frame, XCB_STACK_MODE_ABOVE });
+        restack(t, NULL, XCB_STACK_MODE_ABOVE);
+        below = t;
+    }
 }
 
 void
@@ -137,17 +1306,21 @@ window_focus(struct window *win)
 {
     xcb_window_t to_focus;
 
+    PROBE1(window_focus, win != NULL ? win->id : XCB_NONE);
+
     if (win && win == current)
         return;
 
     if (current != NULL) {
-        xcb_change_window_attributes(wm.conn, current->id,
-            XCB_CW_BORDER_PIXEL, &wm.border_inactive);
+        XCB_SEND(wm.conn, change_window_attributes, current->id,
+            current->frame, XCB_CW_BORDER_PIXEL,
+            (const uint32_t []) { border_pixel(current, false) });
     }
 
     if (win) {
-        xcb_change_window_attributes(wm.conn, win->id, XCB_CW_BORDER_PIXEL,
-            &wm.border_active);
+        XCB_SEND(wm.conn, change_window_attributes, win->id, win->frame,
+            XCB_CW_BORDER_PIXEL,
+            (const uint32_t []) { border_pixel(win, true) });
         current = win;
         to_focus = win->id;
     } else {
@@ -155,20 +1328,22 @@ window_focus(struct window *win)
         to_focus = wm.screen->root;
     }
 
-    LOG("focus %x\n", to_focus);
+    LOG(MSG_FOCUS, to_focus);
 
-    xcb_set_input_focus(wm.conn, XCB_INPUT_FOCUS_PARENT, to_focus,
-        XCB_CURRENT_TIME);
+    XCB_SEND(wm.conn, set_input_focus, to_focus, XCB_INPUT_FOCUS_PARENT,
+        to_focus, XCB_CURRENT_TIME);
 }
 
 void
 window_close(struct window *win)
 {
-    LOG("close %x\n", win->id);
+    PROBE1(window_close, win->id);
+
+    LOG(MSG_CLOSE, win->id);
 
     // In fact, this does not "close" the window, but forces the close down of
     // the owner of the window, like xkill(1) does. It's very dangerous.
     // To close the window gracefully, we should send WM_DELETE_WINDOW
     // ClientMessage to the client.
-    xcb_kill_client(wm.conn, win->id);
+    XCB_SEND(wm.conn, kill_client, win->id, win->id);
 }
@@ -1,28 +1,115 @@
 #ifndef WM0_WINDOW_H
 #define WM0_WINDOW_H
 
+#include <stdbool.h>
 #include <xcb/xcb.h>
+#include <xcb/sync.h>
+#include <xcb/damage.h>
+#include <xcb/render.h>
 #include "queue.h"
 
+// Values of WM_STATE (ICCCM 4.1.3.1)
+enum {
+    WM_STATE_WITHDRAWN = 0,
+    WM_STATE_NORMAL = 1,
+    WM_STATE_ICONIC = 3
+};
+
 // This structure represents a window managed by the WM.
+// The geometry is that of the frame, if the window is in a frame: the frame
+// has the border, and the window fills the inside of the frame.
 // All windows are added to the TAILQ when it is mapped, and removed when it
-// is unmapped.
+// is unmapped by the client. Windows unmapped by the WM (on the other
+// desktops, or iconified) are kept, with their passive grabs.
 struct window {
     TAILQ_ENTRY(window) link;  // link for the window list
+    struct window *hash_next;  // Next window in the bucket of the hash table
+    struct window *leader;     // Window this is transient for, or NULL
+    TAILQ_HEAD(, window) transients;  // Transients of this window, from the
+                                      //   bottom to the top of the stack
+    TAILQ_ENTRY(window) group_link;   // link for the transients of the leader
+    TAILQ_ENTRY(window) stack_link;   // link for the stacking order
+    TAILQ_ENTRY(window) tile_link;    // link for the tiled windows (tile.c)
     xcb_window_t id;           // XID of the window
-    int16_t x, y;              // Coordinate of the window (relative to parent)
+    xcb_window_t frame;        // Frame containing the window, or id itself
+                               //   if frames are not used
+    int16_t x, y;              // Coordinate of the window (relative to root)
     uint16_t w, h;             // Width and height of the window
+    uint16_t bw;               // Border width of the window
+    uint8_t desktop;           // Desktop the window belongs to
+    bool iconic;               // Whether the window is iconified
+    bool focus;                // Whether to focus the window when mapped
+    bool tiled;                // Whether the window is tiled (tile.c)
+    bool argb;                 // Whether the frame has an alpha channel
+    uint64_t place_key;        // Key of the remembered position (places.c),
+                               //   or 0 if not remembered
+    unsigned int ignore_unmap; // Number of UnmapNotify caused by the WM
+    unsigned int hints_sequence;  // GetProperty of WM_NORMAL_HINTS waiting
+                                  //   for the reply, or 0
+    struct {                   // Size hints (WM_NORMAL_HINTS)
+        uint16_t min_w, min_h;    // Minimum size
+        uint16_t max_w, max_h;    // Maximum size (0 if not limited)
+        uint16_t inc_w, inc_h;    // Resize increments (0 if not specified)
+        uint16_t base_w, base_h;  // Base size for the increments
+        float min_aspect;         // Minimum aspect ratio (h / w), or 0
+        float max_aspect;         // Maximum aspect ratio (w / h), or 0
+    } hints;
+    struct {                   // _NET_WM_SYNC_REQUEST
+        xcb_sync_counter_t counter;  // Counter updated by the client, or 0
+        xcb_sync_alarm_t alarm;      // Alarm on the counter, or 0
+        int64_t value;               // Value of the last request
+        bool waiting;                // Whether the client is redrawing
+    } sync;
+    struct {                   // Compositing (compositor.c)
+        xcb_damage_damage_t damage;    // Damage of the frame, or 0
+        xcb_pixmap_t pixmap;           // Contents of the frame, or 0
+        xcb_render_picture_t picture;  // Picture of the pixmap, or 0
+        bool mapped;                   // Whether the frame is mapped
+        bool dirty;                    // Whether the damage is pending
+        struct window *next_dirty;     // Next window with pending damage
+        struct {                       // Thumbnail in the overview
+            xcb_pixmap_t pixmap;           // Cached thumbnail, or 0
+            xcb_render_picture_t picture;  // Picture of the pixmap, or 0
+            int16_t x, y;                  // Position in the overview
+            uint16_t w, h;                 // Size of the thumbnail
+            bool shown;                    // Whether shown in the overview
+            bool stale;                    // Whether to render it again
+        } thumb;
+    } comp;
 };
 
+// Managed windows from the bottom to the top of the stack
+TAILQ_HEAD(window_stack, window);
+
 void window_init(void);
+void window_scan(void);
 struct window *window_get_current(void);
 struct window *window_find(xcb_window_t id);
-struct window *window_manage(xcb_window_t id);
-void window_unmanage(struct window *win);
+struct window *window_bottom(void);
+struct window *window_top(void);
+struct window *window_manage(xcb_window_t id,
+    const xcb_get_window_attributes_reply_t *attributes, bool recall);
+void window_unmanage(struct window *win, bool destroyed);
 void window_unmanage_all(void);
 void window_map(struct window *win);
+void window_unmap(struct window *win);
+void window_switch_desktop(uint8_t desktop);
+void window_send_to_desktop(struct window *win, uint8_t desktop);
+void window_show_all(void);
+void window_iconify(struct window *win);
+void window_restore(struct window *win);
+void window_regrab_buttons(void);
+void window_repaint_borders(bool active, bool inactive);
 void window_move(struct window *win, int16_t x, int16_t y);
 void window_resize(struct window *win, uint16_t w, uint16_t h);
+void window_move_resize(struct window *win, int16_t x, int16_t y, uint16_t w,
+    uint16_t h);
+void window_update_hints(struct window *win);
+void window_poll_hints(void);
+void window_update_sync(struct window *win);
+void window_configure(struct window *win,
+    const xcb_configure_request_event_t *ev);
+void window_notify_moved(struct window *win);
 void window_raise(struct window *win);
 void window_focus(struct window *win);
 void window_close(struct window *win);
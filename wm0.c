@@ -1,28 +1,68 @@
 // wm0 - A small X11 window manager (WM) with libxcb.
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 #include <xcb/xcb.h>
 #include <xcb/xcb_aux.h>    // for xcb_aux_*
-#include <xcb/xcb_event.h>  // for xcb_event_* and XCB_EVENT_RESPONSE_TYPE
+#include <xcb/sync.h>
+#include <xcb/randr.h>
+#include <xcb/composite.h>
+#include <xcb/damage.h>
+#include <xcb/xfixes.h>
+#include <xcb/render.h>
 #include "wm0.h"
 #include "window.h"
+#include "monitor.h"
+#include "compositor.h"
+#include "tile.h"
+#include "places.h"
+#include "batch.h"
+#include "io.h"
+
+#define KEYSYM_TAB   0xff09  // XK_Tab in X11/keysymdef.h
+#define KEYSYM_SPACE 0x0020  // XK_space
 
 struct wm wm;  // Global state of the WM
+static bool io_thread;  // Whether events are read by the I/O thread (io.c)
+static int dump_pipe[2] = { -1, -1 };  // Written by SIGUSR2 for the accounts
+static bool dynamic_colors;  // Whether colors are allocated in the colormap
 
-// Event handlers
-void handle_map_request(xcb_map_request_event_t *ev);
-void handle_unmap_notify(xcb_unmap_notify_event_t *ev);
-void handle_destroy_notify(xcb_destroy_notify_event_t *ev);
-void handle_configure_request(xcb_configure_request_event_t *ev);
-void handle_button_press(xcb_button_press_event_t *ev);
-void handle_button_release(xcb_button_release_event_t *ev);
-void handle_motion_notify(xcb_motion_notify_event_t *ev);
+// Names of the atoms in struct atoms
+static const struct {
+    const char *name;
+    size_t offset;
+} atom_names[] = {
+    { "WM_PROTOCOLS",                 offsetof(struct atoms, wm_protocols) },
+    { "WM_STATE",                     offsetof(struct atoms, wm_state) },
+    { "WM_CHANGE_STATE",              offsetof(struct atoms, wm_change_state) },
+    { "_NET_WM_SYNC_REQUEST",         offsetof(struct atoms, net_wm_sync_request) },
+    { "_NET_WM_SYNC_REQUEST_COUNTER", offsetof(struct atoms, net_wm_sync_request_counter) },
+    { "WM_WINDOW_ROLE",               offsetof(struct atoms, wm_window_role) },
+};
 
 static uint32_t alloc_color(char *rgb_string);
+static void free_color(uint32_t pixel);
+static bool has_dynamic_colors(void);
+static void init_atoms(void);
+static void init_sync(void);
+static void init_randr(void);
+static xcb_render_pictformat_t find_format(
+    xcb_render_query_pict_formats_reply_t *r, xcb_visualid_t visual);
+static void init_compositing(void);
+static void init_keys(void);
+static void grab_keys(void);
+static void request_dump(int sig);
 static void init(void);
-static void scan(void);
+static void reload(void);
+static xcb_generic_event_t *poll_for_queued_event(void);
 static void run(void);
 static void cleanup(void);
 
@@ -42,6 +82,303 @@ alloc_color(char *rgb_string)
     return pixel;
 }
 
+// Release a pixel value got by alloc_color().
+static void
+free_color(uint32_t pixel)
+{
+    if (dynamic_colors)
+        xcb_free_colors(wm.conn, wm.screen->default_colormap, 0, 1, &pixel);
+}
+
+// Check whether the root visual allocates colors in the colormap, rather
+// than computing pixels from RGB values (TrueColor).
+static bool
+has_dynamic_colors(void)
+{
+    xcb_depth_iterator_t d;
+    xcb_visualtype_iterator_t v;
+
+    for (d = xcb_screen_allowed_depths_iterator(wm.screen); d.rem;
+        xcb_depth_next(&d)) {
+        for (v = xcb_depth_visuals_iterator(d.data); v.rem;
+            xcb_visualtype_next(&v)) {
+            // GrayScale, PseudoColor and DirectColor are odd.
+            if (v.data->visual_id == wm.screen->root_visual)
+                return v.data->_class & 1;
+        }
+    }
+    return false;
+}
+
+// Intern the atoms in atom_names.
+// All requests are sent before waiting for the replies.
+static void
+init_atoms(void)
+{
+    xcb_intern_atom_cookie_t cookies[LENGTH(atom_names)];
+
+    for (int i = 0; i < LENGTH(atom_names); ++i) {
+        cookies[i] = xcb_intern_atom_unchecked(wm.conn, false,
+            strlen(atom_names[i].name), atom_names[i].name);
+    }
+    for (int i = 0; i < LENGTH(atom_names); ++i) {
+        xcb_intern_atom_reply_t *r;
+
+        r = XCB_REPLY(wm.conn, intern_atom, cookies[i], NULL);
+        *(xcb_atom_t *)((char *)&wm.atoms + atom_names[i].offset) =
+            (r != NULL) ? r->atom : XCB_NONE;
+        free(r);
+    }
+}
+
+// Initialize XSync extension, which is needed for _NET_WM_SYNC_REQUEST.
+// If it is not available, windows are resized without synchronization.
+static void
+init_sync(void)
+{
+    const xcb_query_extension_reply_t *ext;
+    xcb_sync_initialize_reply_t *r;
+
+    wm.sync_event = 0;
+    ext = xcb_get_extension_data(wm.conn, &xcb_sync_id);
+    if (ext == NULL || !ext->present)
+        return;
+    r = XCB_REQUEST_AND_REPLY(wm.conn, sync_initialize, NULL,
+        XCB_SYNC_MAJOR_VERSION, XCB_SYNC_MINOR_VERSION);
+    if (r != NULL)
+        wm.sync_event = ext->first_event;
+    free(r);
+}
+
+// Fetch the monitors from RandR, and select the events to keep them up to
+// date. If RandR is not available, the whole screen is a single monitor.
+static void
+init_randr(void)
+{
+    const xcb_query_extension_reply_t *ext;
+    xcb_randr_query_version_cookie_t version;
+    xcb_randr_get_screen_resources_current_cookie_t resources;
+    xcb_randr_get_crtc_info_cookie_t cookies[MAX_MONITORS];
+    xcb_randr_query_version_reply_t *v;
+    xcb_randr_get_screen_resources_current_reply_t *r;
+    xcb_randr_crtc_t *crtcs;
+    struct monitor monitors[MAX_MONITORS];
+    int n, nmonitors = 0;
+
+    wm.randr_event = 0;
+    ext = xcb_get_extension_data(wm.conn, &xcb_randr_id);
+    if (ext == NULL || !ext->present)
+        return;
+
+    // CRTCs need RandR 1.2, and GetScreenResourcesCurrent 1.3.
+    version = xcb_randr_query_version(wm.conn, 1, 3);
+    resources = xcb_randr_get_screen_resources_current(wm.conn,
+        wm.screen->root);
+    v = XCB_REPLY(wm.conn, randr_query_version, version, NULL);
+    r = XCB_REPLY(wm.conn, randr_get_screen_resources_current, resources,
+        NULL);
+    if (v == NULL || r == NULL ||
+        (v->major_version == 1 && v->minor_version < 3)) {
+        free(v);
+        free(r);
+        return;
+    }
+
+    crtcs = xcb_randr_get_screen_resources_current_crtcs(r);
+    n = MIN(xcb_randr_get_screen_resources_current_crtcs_length(r),
+        MAX_MONITORS);
+    for (int i = 0; i < n; ++i) {
+        cookies[i] = xcb_randr_get_crtc_info(wm.conn, crtcs[i],
+            r->config_timestamp);
+    }
+    for (int i = 0; i < n; ++i) {
+        xcb_randr_get_crtc_info_reply_t *crtc;
+
+        crtc = XCB_REPLY(wm.conn, randr_get_crtc_info, cookies[i], NULL);
+        if (crtc != NULL && crtc->mode != XCB_NONE) {
+            monitors[nmonitors++] = (struct monitor) {
+                crtcs[i], crtc->x, crtc->y, crtc->width, crtc->height
+            };
+        }
+        free(crtc);
+    }
+    monitor_set(monitors, nmonitors);
+
+    xcb_randr_select_input(wm.conn, wm.screen->root,
+        XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE |
+        XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE);
+    wm.randr_event = ext->first_event;
+    free(v);
+    free(r);
+}
+
+// Find the picture format of the visual in the reply for QueryPictFormats.
+static xcb_render_pictformat_t
+find_format(xcb_render_query_pict_formats_reply_t *r, xcb_visualid_t visual)
+{
+    xcb_render_pictscreen_iterator_t s;
+    xcb_render_pictdepth_iterator_t d;
+    xcb_render_pictvisual_iterator_t v;
+
+    for (s = xcb_render_query_pict_formats_screens_iterator(r); s.rem;
+        xcb_render_pictscreen_next(&s)) {
+        for (d = xcb_render_pictscreen_depths_iterator(s.data); d.rem;
+            xcb_render_pictdepth_next(&d)) {
+            for (v = xcb_render_pictdepth_visuals_iterator(d.data); v.rem;
+                xcb_render_pictvisual_next(&v)) {
+                if (v.data->visual == visual)
+                    return v.data->format;
+            }
+        }
+    }
+    return XCB_NONE;
+}
+
+// Initialize the extensions for compositing (-c): Composite to redirect the
+// frames, Damage to track their contents, XFixes for the regions to repaint,
+// and Render to paint. If any of them is not available, the frames are drawn
+// by the server as usual.
+static void
+init_compositing(void)
+{
+    const xcb_query_extension_reply_t *composite, *damage, *xfixes, *render;
+    xcb_composite_query_version_cookie_t composite_version;
+    xcb_damage_query_version_cookie_t damage_version;
+    xcb_xfixes_query_version_cookie_t xfixes_version;
+    xcb_render_query_version_cookie_t render_version;
+    xcb_render_query_pict_formats_cookie_t formats;
+    xcb_composite_query_version_reply_t *c;
+    xcb_damage_query_version_reply_t *d;
+    xcb_xfixes_query_version_reply_t *x;
+    xcb_render_query_version_reply_t *r;
+    xcb_render_query_pict_formats_reply_t *f;
+    xcb_render_pictformat_t format = XCB_NONE;
+
+    wm.damage_event = 0;
+    composite = xcb_get_extension_data(wm.conn, &xcb_composite_id);
+    damage = xcb_get_extension_data(wm.conn, &xcb_damage_id);
+    xfixes = xcb_get_extension_data(wm.conn, &xcb_xfixes_id);
+    render = xcb_get_extension_data(wm.conn, &xcb_render_id);
+    if (composite == NULL || !composite->present || damage == NULL ||
+        !damage->present || xfixes == NULL || !xfixes->present ||
+        render == NULL || !render->present)
+        goto unavailable;
+
+    // The versions must be negotiated before using the extensions.
+    // NameWindowPixmap needs Composite 0.2, and regions XFixes 2.0.
+    composite_version = xcb_composite_query_version(wm.conn, 0, 2);
+    damage_version = xcb_damage_query_version(wm.conn, 1, 1);
+    xfixes_version = xcb_xfixes_query_version(wm.conn, 2, 0);
+    render_version = xcb_render_query_version(wm.conn, 0, 11);
+    formats = xcb_render_query_pict_formats(wm.conn);
+    c = XCB_REPLY(wm.conn, composite_query_version, composite_version, NULL);
+    d = XCB_REPLY(wm.conn, damage_query_version, damage_version, NULL);
+    x = XCB_REPLY(wm.conn, xfixes_query_version, xfixes_version, NULL);
+    r = XCB_REPLY(wm.conn, render_query_version, render_version, NULL);
+    f = XCB_REPLY(wm.conn, render_query_pict_formats, formats, NULL);
+    if (c != NULL && d != NULL && x != NULL && r != NULL && f != NULL &&
+        (c->major_version > 0 || c->minor_version >= 2) &&
+        x->major_version >= 2)
+        format = find_format(f, wm.screen->root_visual);
+    free(c);
+    free(d);
+    free(x);
+    free(r);
+    free(f);
+    if (format == XCB_NONE)
+        goto unavailable;
+
+    compositor_start(format);
+    wm.damage_event = damage->first_event;
+    return;
+
+unavailable:
+    fputs("compositing is not available\n", stderr);
+    wm.compositing = false;
+}
+
+// Find the keycodes of the keys 1-9 for the desktops, and Tab for the
+// overview.
+static void
+init_keys(void)
+{
+    const xcb_setup_t *setup = xcb_get_setup(wm.conn);
+    xcb_get_keyboard_mapping_reply_t *r;
+    xcb_keysym_t *keysyms;
+    int n;
+
+    r = XCB_REQUEST_AND_REPLY(wm.conn, get_keyboard_mapping, NULL,
+        setup->min_keycode, setup->max_keycode - setup->min_keycode + 1);
+    if (r == NULL || r->keysyms_per_keycode == 0) {
+        free(r);
+        return;
+    }
+    keysyms = xcb_get_keyboard_mapping_keysyms(r);
+    n = xcb_get_keyboard_mapping_keysyms_length(r);
+
+    // Only the first keysym of each keycode (without modifiers) is checked.
+    for (int i = 0; i < n; i += r->keysyms_per_keycode) {
+        // Keysyms of the digits are the same as ASCII.
+        int desktop = (int)keysyms[i] - '1';
+
+        if (desktop >= 0 && desktop < DESKTOPS && wm.keycodes[desktop] == 0) {
+            wm.keycodes[desktop] =
+                setup->min_keycode + i / r->keysyms_per_keycode;
+        }
+        if (keysyms[i] == KEYSYM_TAB && wm.overview_key == 0)
+            wm.overview_key = setup->min_keycode + i / r->keysyms_per_keycode;
+        if (keysyms[i] == KEYSYM_SPACE && wm.layout_key == 0)
+            wm.layout_key = setup->min_keycode + i / r->keysyms_per_keycode;
+    }
+    free(r);
+}
+
+// Establish a passive grab of the keys for the desktops, the layouts (and the
+// overview, while compositing) on the root window.
+static void
+grab_keys(void)
+{
+    uint16_t modifiers[] = {
+        0, XCB_MOD_MASK_LOCK,
+        XCB_MOD_MASK_SHIFT, XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_LOCK
+    };
+
+    xcb_ungrab_key(wm.conn, XCB_GRAB_ANY, wm.screen->root, XCB_MOD_MASK_ANY);
+    for (int i = 0; i < DESKTOPS; ++i) {
+        if (wm.keycodes[i] == 0)
+            continue;
+        for (int j = 0; j < LENGTH(modifiers); ++j) {
+            xcb_grab_key(wm.conn, true, wm.screen->root,
+                wm.conf.modkey | modifiers[j], wm.keycodes[i],
+                XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+        }
+    }
+    // Modifiers without Shift
+    for (int j = 0; j < 2; ++j) {
+        if (wm.layout_key != 0) {
+            xcb_grab_key(wm.conn, true, wm.screen->root,
+                wm.conf.modkey | modifiers[j], wm.layout_key,
+                XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+        }
+        if (wm.compositing && wm.overview_key != 0) {
+            xcb_grab_key(wm.conn, true, wm.screen->root,
+                wm.conf.modkey | modifiers[j], wm.overview_key,
+                XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+        }
+    }
+}
+
+// Ask the event loop to write the accounts of the clients (see account.c).
+// The pipe wakes up the loop even if the signal arrives just before poll().
+static void
+request_dump(int sig)
+{
+    int saved = errno;
+
+    (void)write(dump_pipe[1], "", 1);
+    errno = saved;
+}
+
 // Initialize everything.
 static void
 init(void)
@@ -53,6 +390,9 @@ init(void)
         XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY |   // for UnmapNotify and DestroyNotify
         XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT;  // for MapRequest and ConfigureRequest
 
+    // The root is painted by the compositor.
+    if (wm.compositing)
+        root_event_mask |= XCB_EVENT_MASK_EXPOSURE;  // for Expose
     wm.conn = xcb_connect(NULL, &screen_num);
     if (xcb_connection_has_error(wm.conn)) {
         fputs("cannot open display\n", stderr);
@@ -71,41 +411,84 @@ init(void)
     }
 
     wm.grab.mode = NO_GRAB;
-    wm.border_active = alloc_color(COLOR_ACTIVE);
-    wm.border_inactive = alloc_color(COLOR_INACTIVE);
+    conf_load(&wm.conf);
+    log_open();
+    account_init(xcb_get_setup(wm.conn)->resource_id_mask);
+    if (pipe(dump_pipe) == 0) {
+        fcntl(dump_pipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(dump_pipe[1], F_SETFL, O_NONBLOCK);
+        sigaction(SIGUSR2, &(struct sigaction) { .sa_handler = request_dump },
+            NULL);
+    }
+    xcb_prefetch_extension_data(wm.conn, &xcb_sync_id);
+    xcb_prefetch_extension_data(wm.conn, &xcb_randr_id);
+    if (wm.compositing) {
+        xcb_prefetch_extension_data(wm.conn, &xcb_composite_id);
+        xcb_prefetch_extension_data(wm.conn, &xcb_damage_id);
+        xcb_prefetch_extension_data(wm.conn, &xcb_xfixes_id);
+        xcb_prefetch_extension_data(wm.conn, &xcb_render_id);
+    }
+    init_atoms();
+    init_sync();
+    init_randr();
+    if (wm.compositing)
+        init_compositing();
+    init_keys();
+    grab_keys();
+    dynamic_colors = has_dynamic_colors();
+    wm.border_active = alloc_color(wm.conf.color_active);
+    wm.border_inactive = alloc_color(wm.conf.color_inactive);
 
     window_init();
 }
 
-// Scan existing windows and manage them.
+// Reload the configuration file, and apply the changes to the managed
+// windows without rescanning them.
 static void
-scan(void)
+reload(void)
 {
-    xcb_query_tree_reply_t *tree;
-    xcb_window_t *children;
-    int n;
-    struct window *win = NULL;
+    struct conf old = wm.conf;
+    bool active, inactive;
 
-    tree = XCB_REQUEST_AND_REPLY(wm.conn, query_tree, NULL, wm.screen->root);
-    children = xcb_query_tree_children(tree);
-    n = xcb_query_tree_children_length(tree);
-    for (int i = 0; i < n; ++i) {
-        xcb_get_window_attributes_reply_t *r;
-
-        r = XCB_REQUEST_AND_REPLY(wm.conn, get_window_attributes, NULL,
-            children[i]);
-
-        // Windows with override_redirect flag is not handled by
-        // non-compositing WM.
-        // In addition, we only manage mapped windows.
-        // If we support minimization, we should consider unmapped windows,
-        // because minimization is usually accomplished by unmapping windows.
-        if (!r->override_redirect && r->map_state == XCB_MAP_STATE_VIEWABLE)
-            win = window_manage(children[i]);
-        free(r);
+    LOG(MSG_RELOAD, 0);
+
+    conf_load(&wm.conf);
+
+    if (wm.conf.button_move != old.button_move ||
+        wm.conf.button_resize != old.button_resize ||
+        wm.conf.button_close != old.button_close ||
+        wm.conf.modkey != old.modkey)
+        window_regrab_buttons();
+    if (wm.conf.modkey != old.modkey)
+        grab_keys();
+
+    active = strcmp(wm.conf.color_active, old.color_active) != 0;
+    if (active) {
+        free_color(wm.border_active);
+        wm.border_active = alloc_color(wm.conf.color_active);
+    }
+    inactive = strcmp(wm.conf.color_inactive, old.color_inactive) != 0;
+    if (inactive) {
+        free_color(wm.border_inactive);
+        wm.border_inactive = alloc_color(wm.conf.color_inactive);
+    }
+    if (active || inactive)
+        window_repaint_borders(active, inactive);
+
+    // The layouts set by Modkey + Space are reset to the new default.
+    if (wm.conf.layout != old.layout ||
+        wm.conf.master_size != old.master_size) {
+        for (int i = 0; i < DESKTOPS; ++i)
+            tile_set_layout(i, wm.conf.layout);
+        tile_arrange(wm.desktop);
     }
-    free(tree);
-    window_focus(win);
+}
+
+// Get an event already read from the connection, if any.
+static xcb_generic_event_t *
+poll_for_queued_event(void)
+{
+    return io_thread ? io_pop() : xcb_poll_for_queued_event(wm.conn);
 }
 
 // Process events.
@@ -113,43 +496,84 @@ static void
 run(void)
 {
     xcb_generic_event_t *event;
+    struct pollfd fds[] = {
+        { .fd = io_thread ? io_fd() : xcb_get_file_descriptor(wm.conn),
+          .events = POLLIN },
+        { .fd = conf_watch(), .events = POLLIN },  // -1 if not available
+        { .fd = dump_pipe[0], .events = POLLIN },  // -1 if not available
+    };
+    char buf[16];
 
     // This is the main event loop of WM.
-    while ((event = xcb_wait_for_event(wm.conn)) != NULL) {
-        if (event->response_type == 0) {
-            xcb_generic_error_t *e = (xcb_generic_error_t *)event;
-
-            // We ignore BadWindow error, since it is sometimes not avoidable.
-            // The window we operate can be unmapped or destroyed by its owner
-            // process, just after we send a request about it, which results in
-            // a BadWindow error.
-            if (e->error_code != XCB_WINDOW) {
-                fprintf(stderr, "X protocol error: request=%s, error=%s\n",
-                    xcb_event_get_request_label(e->major_code),
-                    xcb_event_get_error_label(e->error_code));
+    for (;;) {
+        for (;;) {
+            // Pass the events already received to the scheduler, which
+            // decides the order to handle them (see batch.c).
+            // The connection is read only when there is nothing to handle.
+            while (!batch_full() &&
+                (event = poll_for_queued_event()) != NULL) {
+                PROBE2(event_receive, event->response_type,
+                    event->full_sequence);
+                free(batch_push(event));
             }
-        } else {
-#define HANDLE_EVENT(type, handler) case type: handler((void *)event); break
-
-            // Dispatch the event to the appropriate function.
-            switch (XCB_EVENT_RESPONSE_TYPE(event)) {
-                HANDLE_EVENT(XCB_MAP_REQUEST, handle_map_request);
-                HANDLE_EVENT(XCB_UNMAP_NOTIFY, handle_unmap_notify);
-                HANDLE_EVENT(XCB_DESTROY_NOTIFY, handle_destroy_notify);
-                HANDLE_EVENT(XCB_CONFIGURE_REQUEST, handle_configure_request);
-                HANDLE_EVENT(XCB_BUTTON_PRESS, handle_button_press);
-                HANDLE_EVENT(XCB_BUTTON_RELEASE, handle_button_release);
-                HANDLE_EVENT(XCB_MOTION_NOTIFY, handle_motion_notify);
+            if ((event = batch_pop()) == NULL) {
+                // The I/O thread reads the connection by itself.
+                if (io_thread || (event = xcb_poll_for_event(wm.conn)) == NULL)
+                    break;
+                PROBE2(event_receive, event->response_type,
+                    event->full_sequence);
+                free(batch_push(event));
+                continue;
             }
 
-#undef HANDLE_EVENT
+            // Events are recorded in the order they are handled, so that
+            // the trace can be replayed deterministically.
+            trace_event(event);
+            watchdog_begin(event);
+            account_begin(event);
+            origin_begin(event);
+            PROBE2(event_dispatch, event->response_type,
+                event->full_sequence);
+            handle_event(event);
+            PROBE1(event_done, event->response_type);
+            origin_end();
+            account_end();
+            watchdog_end();
+            free(event);
 
             // Requests are buffered and not always automatically sent to the
             // server, so we need to flush the queue.
             // See also: http://lists.freedesktop.org/archives/xcb/2008-December/004152.html
             xcb_flush(wm.conn);
         }
-        free(event);
+        if (xcb_connection_has_error(wm.conn))
+            break;
+
+        // Take the replies which arrived with the events.
+        window_poll_hints();
+
+        // Repaint what the events have changed, once for all of them.
+        if (wm.compositing) {
+            compositor_paint();
+            xcb_flush(wm.conn);
+        }
+
+        // Wait for events from the X server, or changes of the configuration
+        // file.
+        trace_flush();
+        if (poll(fds, LENGTH(fds), -1) < 0 && errno != EINTR)
+            break;
+        if (io_thread && (fds[0].revents & POLLIN))
+            io_clear();
+        if (fds[2].revents & POLLIN) {
+            while (read(dump_pipe[0], buf, sizeof(buf)) > 0)
+                ;
+            account_dump(stdout);
+        }
+        if ((fds[1].revents & POLLIN) && conf_changed(fds[1].fd)) {
+            reload();
+            xcb_flush(wm.conn);
+        }
     }
 }
 
@@ -157,15 +581,76 @@ run(void)
 static void
 cleanup(void)
 {
+    window_show_all();
     window_unmanage_all();
+    places_close();
+    compositor_stop();
+    xcb_flush(wm.conn);
+    watchdog_stop();
+    if (io_thread)
+        io_stop();
+    trace_close();
+    log_close();
     xcb_disconnect(wm.conn);
 }
 
 int
-main(void)
+main(int argc, char *argv[])
 {
+    const char *trace_file = NULL, *places_file = NULL;
+    int c, stall = 0;
+
+    while ((c = getopt(argc, argv, "cfip:t:w:")) != -1) {
+        switch (c) {
+        case 'c':
+            // Compositing works on the frames.
+            wm.compositing = wm.frames = true;
+            break;
+        case 'f':
+            wm.frames = true;
+            break;
+        case 'i':
+            io_thread = true;
+            break;
+        case 'p':
+            places_file = optarg;
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'w':
+            stall = atoi(optarg);
+            break;
+        default:
+            fputs("usage: wm0 [-cfi] [-p places_file] [-t trace_file] [-w ms]\n",
+                stderr);
+            return 1;
+        }
+    }
+
     init();
-    scan();
+    // Open the places before window_scan(), so that the positions of the
+    // windows already mapped are remembered when they are closed (they are
+    // not moved), and before trace_open(), which records whether positions
+    // are remembered.
+    if (places_file != NULL && !places_open(places_file))
+        perror(places_file);
+    // Start recording after init(), so that the trace begins with the
+    // replies for window_scan().
+    if (trace_file != NULL && !trace_open(trace_file)) {
+        perror(trace_file);
+        return 1;
+    }
+    window_scan();
+    xcb_flush(wm.conn);
+    // Start the I/O thread after window_scan(), so that the events are
+    // handled in the order they are received.
+    if (io_thread && !io_start(wm.conn)) {
+        fputs("cannot start the I/O thread\n", stderr);
+        io_thread = false;
+    }
+    if (stall > 0 && !watchdog_start(stall))
+        fputs("cannot start the watchdog\n", stderr);
     run();
     cleanup();
     return 0;
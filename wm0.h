@@ -4,24 +4,56 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <xcb/xcb.h>
-#include "config.h"
+#include "atoms.h"
+#include "conf.h"
+#include "log.h"
+#include "trace.h"
+#include "account.h"
+#include "origin.h"
+#include "probe.h"
+#include "watchdog.h"
 
 #define LENGTH(a) (sizeof(a) / sizeof(a[0]))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
 
-#ifdef DEBUG
-#define LOG(...) printf(__VA_ARGS__)
-#else
-#define LOG(...)
-#endif
+// Log a message (MSG_*) with XID and up to two arguments, if the level of
+// the message is enabled. This only stores a binary record, which is
+// formatted by another thread (see log.c).
+#define LOG(...) LOG_(__VA_ARGS__, 0, 0, 0)
+#define LOG_(msg, xid, a, b, ...) do { \
+    if (wm.conf.log_level >= log_levels[msg]) \
+        log_write(msg, xid, a, b); \
+} while (0)
 
 // Send a request, and then get its result
+// These macros block, so the request is told to the watchdog (watchdog.c),
+// and to the probes reply_wait and reply_done (probe.h).
 #define XCB_REQUEST_AND_CHECK(conn, request, ...) \
-    xcb_request_check(conn, xcb_ ## request ## _checked(conn, __VA_ARGS__))
+    (watchdog_wait(#request), probe_wait(#request), \
+        watchdog_reply(probe_reply(#request, xcb_request_check(conn, \
+            xcb_ ## request ## _checked(conn, __VA_ARGS__)))))
 
-// Send a request, and then get its reply
+// Send a request, and then get its reply (which is recorded if tracing)
 #define XCB_REQUEST_AND_REPLY(conn, request, e, ...) \
-    xcb_ ## request ## _reply(conn, xcb_ ## request ## _unchecked(conn, \
-        __VA_ARGS__), e)
+    XCB_REPLY(conn, request, xcb_ ## request ## _unchecked(conn, __VA_ARGS__), e)
+
+// Get the reply of a request sent before
+// Sending several requests before getting their replies saves round trips.
+#define XCB_REPLY(conn, request, cookie, e) \
+    (watchdog_wait(#request), probe_wait(#request), \
+        trace_reply(watchdog_reply(probe_reply(#request, \
+            xcb_ ## request ## _reply(conn, cookie, e)))))
+
+// Send a request about the window of a client, which is accounted to the
+// client (see account.c) and noted for its errors (see origin.c), and return
+// its sequence number.
+#define XCB_SEND(conn, request, window, ...) \
+    origin_note(account_request(window, \
+        xcb_ ## request(conn, __VA_ARGS__).sequence), window, #request)
+
+// Number of virtual desktops, switched by Modkey + 1-9
+#define DESKTOPS 9
 
 // State of the mouse pointer
 enum {
@@ -36,12 +68,36 @@ struct wm {
     xcb_screen_t *screen;      // X11 screen
     struct {
         int mode;              // State of the mouse pointer
-        int16_t x, y;          // Previous coordinate of the mouse pointer
+        int16_t x, y;          // Coordinate of the mouse pointer at the start
+        int16_t win_x, win_y;  // Geometry of the window at the start
+        uint16_t win_w, win_h;
+        unsigned int sequence; // GrabPointer waiting for the reply, or 0
+        bool buffered;         // Whether a motion is pending, until the
+                               //   grab is confirmed or the client redraws
+        int16_t buffered_x;    // Coordinate of the pending motion
+        int16_t buffered_y;
+        xcb_timestamp_t buffered_time;  // Time of the pending motion
+        xcb_timestamp_t time;  // Time of the last resize
     } grab;
+    struct conf conf;          // Configuration
     uint32_t border_active;    // Color for the border of active windows
     uint32_t border_inactive;  // Color for the border of inactive windows
+    struct atoms atoms;        // Interned atoms
+    uint8_t sync_event;        // First event of XSync, or 0 if not available
+    uint8_t randr_event;       // First event of RandR, or 0 if not available
+    bool frames;               // Whether windows are put into frames (-f)
+    bool compositing;          // Whether frames are composited by wm0 (-c)
+    uint8_t damage_event;      // First event of Damage, or 0 if not compositing
+    uint8_t desktop;           // Current desktop
+    xcb_keycode_t keycodes[DESKTOPS];  // Keys for the desktops (1-9), or 0
+    xcb_keycode_t overview_key;        // Key for the overview (Tab), or 0
+    xcb_keycode_t layout_key;          // Key for the layouts (Space), or 0
 };
 
 extern struct wm wm; // State of the WM
 
+// Defined in handlers.c
+void handle_event(xcb_generic_event_t *event);
+xcb_window_t handle_event_window(const xcb_generic_event_t *event);
+
 #endif // WM0_H